@@ -2,33 +2,108 @@
 
 #include <UGM/UGM.h>
 
-struct Slope {
-	float l;
-	float r;
-};
+#include <Curve/BSpline.h>
+#include <Curve/BSplineFit.h>
+#include <Curve/BezierCurve.h>
+#include <Curve/CurveBvh.h>
+#include <Curve/CurveIntersect.h>
+#include <Curve/FrameArena.h>
+#include <Curve/LocalSpline.h>
+#include <Curve/PointGrid.h>
+#include <Curve/PointImport.h>
+#include <Curve/PointStore.h>
+#include <Curve/PolylineLod.h>
+#include <Curve/Spline.h>
+
+#include <algorithm>
+#include <memory>
+
+// sampled curve and the input generations it was built from
+struct CurveCache {
+	size_t points_gen{ 0 };
+	size_t tangent_gen{ 0 };
+	size_t param_gen{ 0 };
+	int fitting_type{ -1 };
+	bool with_slope{ false };
+	bool closed{ false };
+	bool valid{ false };
+
+	SplineCache curve;
+
+	// the B-spline of fitting type 2. It is built again when the number of points, the
+	// parameterization or the degree change, and otherwise only the points that differ from
+	// the control points are moved, each evaluates the degree + 1 spans it supports.
+	BSplineCache bspline;
+	size_t bspline_points_gen{ 0 };
+	size_t bspline_param_gen{ 0 };
+	bool bspline_valid{ false };
+	// a drag moved a control point of bspline but none of the points
+	bool bspline_dragged{ false };
 
-struct Ratio {
-	float l;
-	float r;
-	Ratio() { l = r = 1.f; }
+	// the B-spline of fitting type 4 that approximates the points, fitted again whenever they,
+	// the parameterization or the fit settings change. Empty if the points do not span a curve.
+	BSplineCache fit;
+	size_t fit_points_gen{ 0 };
+	size_t fit_param_gen{ 0 };
+	int fit_control_points{ 0 };
+	float fit_smoothing{ 0.f };
+	bool fit_valid{ false };
+
+	// the Catmull-Rom spline of fitting type 5. It is built again when the number of points, the
+	// parameterization, the shape or closed change, and otherwise only the points that differ
+	// from the knots are moved, each sets the slopes and samples of the four segments around it.
+	SplineCache local;
+	size_t local_points_gen{ 0 };
+	size_t local_param_gen{ 0 };
+	SplineShape local_shape;
+	bool local_closed{ false };
+	bool local_valid{ false };
+
+	// nearest points on the curve of fitting type bvh_type, -1 until it is built. It is built
+	// when a query needs it and dropped whenever the cached curve changes, not by a drag.
+	CurveBvh bvh;
+	int bvh_type{ -1 };
+	// where the curve in bvh crosses itself, found again after every build of bvh
+	std::vector<CurveCrossing> crossings;
+	bool crossings_valid{ false };
+
+	// the samples of the long curve of fitting type lod_type simplified for every zoom, -1 until
+	// it is built. Built and dropped like bvh, a drag patches it as it is drawn.
+	PolylineLod lod;
+	int lod_type{ -1 };
+	// where the samples of every segment of a spline start in lod, and the end of the last
+	std::vector<int> lod_start;
+
+	// the cached curve changed, what is built over it is out of date
+	void changed() { bvh_type = -1, lod_type = -1; }
+	void invalidate() { valid = false, bspline_valid = false, fit_valid = false, local_valid = false, changed(); }
 };
 
 struct CanvasData {
-	std::vector<Ubpa::pointf2> points;
-
-	std::vector<Ubpa::pointf2> ltangent;
-	std::vector<Ubpa::pointf2> rtangent;
-	std::vector<Ratio> tangent_ratio;
-	std::vector<Slope> xk;
-	std::vector<Slope> yk;
+	// positions, slopes and tangent handles of the control points
+	PointStore points;
 
 	Ubpa::valf2 scrolling{ 0.f,0.f };
+	// pixels per unit of the canvas
+	float zoom{ 1.f };
 	bool opt_enable_grid{ true };
 	bool opt_enable_context_menu{ true };
+	bool opt_show_crossings{ false };
 	bool adding_line{ false };
 
 	int param_type{ 0 };
+	// natural spline, Bezier, B-spline, one Bezier curve of degree points - 1, a least squares
+	// B-spline approximation of the points or a Catmull-Rom spline
 	int fitting_type{ 0 };
+	// of the B-spline, lower for fewer points
+	int degree{ 3 };
+	// of the approximation, at most one per point
+	int fit_control_points{ 16 };
+	float fit_smoothing{ 0.f };
+	// Kochanek-Bartels tension, bias and continuity of the Catmull-Rom spline
+	SplineShape shape;
+	// the spline runs back from the last point to the first
+	bool closed{ false };
 	bool enable_add_point{ true };
 	bool adding_last_point{ false };
 	int edit_point{ 0 };
@@ -37,31 +112,188 @@ struct CanvasData {
 	int editing_tan_index = 0; // < 0 is left, > 0 is right, real index = this - 1
 	bool enable_move_tan{ false };
 
+	// bumped on every change of the curve inputs, compared against curve_cache
+	size_t points_gen{ 0 };
+	size_t tangent_gen{ 0 };
+	size_t param_gen{ 0 };
+	// the point set_point moved to reach points_gen, if that was the last change
+	int moved_index{ -1 };
+	size_t moved_gen{ 0 };
+	CurveCache curve_cache;
+	SplineDrag spline_drag;
+	// scratch memory of one frame, reset at the start of every update
+	FrameArena frame_arena;
+
+	// a file of points read on a thread, what it has read is appended at the start of every frame
+	std::shared_ptr<PointImportJob> import_job;
+	char import_path[260]{};
+	bool import_failed{ false };
+	// when the points read so far were last appended
+	double import_time{ 0. };
+	std::vector<float> import_x;
+	std::vector<float> import_y;
+
+	// hit testing, points by index and the drawn handles by 2 * i (left) and 2 * i + 1 (right).
+	// The handles are rewritten by every fit, so that grid is rebuilt lazily after one.
+	PointGrid point_grid;
+	PointGrid handle_grid;
+	bool handle_grid_valid{ false };
+
+	Ubpa::pointf2 point(size_t i) const { return Ubpa::pointf2(points.x[i], points.y[i]); }
+	Ubpa::pointf2 ltangent(size_t i) const { return Ubpa::pointf2(points.lx[i], points.ly[i]); }
+	Ubpa::pointf2 rtangent(size_t i) const { return Ubpa::pointf2(points.rx[i], points.ry[i]); }
+
 	void pop_back() {
+		point_grid.erase((int)points.size() - 1);
+		handle_grid_valid = false;
 		points.pop_back();
-		ltangent.pop_back();
-		rtangent.pop_back();
-		xk.pop_back();
-		yk.pop_back();
-		tangent_ratio.pop_back();
+		++points_gen;
 	}
 
 	void clear() {
 		points.clear();
-		ltangent.clear();
-		rtangent.clear();
-		xk.clear();
-		yk.clear();
-		tangent_ratio.clear();
+		++points_gen;
+		point_grid.clear();
+		handle_grid_valid = false;
 	}
 
 	void push_back(const Ubpa::pointf2& p) {
-		points.push_back(p);
-		ltangent.push_back(Ubpa::pointf2());
-		rtangent.push_back(Ubpa::pointf2());
-		xk.push_back(Slope());
-		yk.push_back(Slope());
-		tangent_ratio.push_back(Ratio());
+		points.push_back(p[0], p[1]);
+		++points_gen;
+		point_grid.insert((int)points.size() - 1, p[0], p[1]);
+		handle_grid_valid = false;
+	}
+
+	// n points at the end at once
+	void append(const float* px, const float* py, size_t n) {
+		int first = (int)points.size();
+		points.append(px, py, n);
+		++points_gen;
+		for (size_t k = 0; k < n; k++)
+			point_grid.insert(first + (int)k, px[k], py[k]);
+		handle_grid_valid = false;
+	}
+
+	// new point at index i, the points from i on move up by one
+	void insert(size_t i, const Ubpa::pointf2& p) {
+		points.insert((int)i, p[0], p[1]);
+		++points_gen;
+		reindex_points();
+	}
+
+	// setters only bump the generation when the value really changes
+	void set_point(size_t i, const Ubpa::pointf2& p) {
+		if (points.x[i] == p[0] && points.y[i] == p[1])
+			return;
+		points.x[i] = p[0];
+		points.y[i] = p[1];
+		++points_gen;
+		moved_index = (int)i;
+		moved_gen = points_gen;
+		point_grid.move((int)i, p[0], p[1]);
+	}
+
+	void set_ltangent(size_t i, const Ubpa::pointf2& p) {
+		points.lx[i] = p[0];
+		points.ly[i] = p[1];
+		++tangent_gen;
+		if (handle_grid_valid && i > 0)
+			handle_grid.move(2 * (int)i, p[0], p[1]);
+	}
+
+	void set_rtangent(size_t i, const Ubpa::pointf2& p) {
+		points.rx[i] = p[0];
+		points.ry[i] = p[1];
+		++tangent_gen;
+		if (handle_grid_valid && i + 1 < points.size())
+			handle_grid.move(2 * (int)i + 1, p[0], p[1]);
+	}
+
+	// index of the point under p, -1 if none
+	int pick_point(const Ubpa::pointf2& p, float r) const {
+		return point_grid.find(p[0], p[1], r);
+	}
+
+	// handle under p in the editing_tan_index convention, 0 if none
+	int pick_tangent(const Ubpa::pointf2& p, float r) {
+		if (!handle_grid_valid) {
+			handle_grid.clear();
+			for (int i = 0; i + 1 < (int)points.size(); i++) {
+				handle_grid.insert(2 * (i + 1), points.lx[i + 1], points.ly[i + 1]);
+				handle_grid.insert(2 * i + 1, points.rx[i], points.ry[i]);
+			}
+			handle_grid_valid = true;
+		}
+		int id = handle_grid.find(p[0], p[1], r);
+		if (id == -1)
+			return 0;
+		return id % 2 == 0 ? -(id / 2 + 1) : id / 2 + 1;
+	}
+
+	// slopes are only edited on open curves
+	void set_closed(bool c) {
+		if (closed == c)
+			return;
+		closed = c;
+		spline_drag.invalidate();
+		if (closed && (edit_point == 2 || edit_point == 3))
+			edit_point = 0;
+	}
+
+	void set_weight(size_t i, float w) {
+		if (points.w[i] == w)
+			return;
+		points.w[i] = w;
+		++points_gen;
+	}
+
+	// insert the knot t into the B-spline, which must be up to date. The points become its
+	// finer control polygon, the curve and its knots stay as they are.
+	void insert_knot(float t) {
+		BSplineCache& b = curve_cache.bspline;
+		int k = InsertKnot(b, t);
+		if (k < 0)
+			return;
+		points.insert(k, b.x[k], b.y[k]);
+		for (int i = std::max(k - b.degree + 1, 0); i <= k; i++) {
+			points.x[i] = b.x[i];
+			points.y[i] = b.y[i];
+			points.w[i] = b.w[i];
+		}
+		++points_gen;
+		reindex_points();
+	}
+
+	// the points become the control polygon of the same Bezier curve one degree higher
+	void elevate_degree() {
+		int n = (int)points.size();
+		float* ex = frame_arena.alloc<float>(n + 1);
+		float* ey = frame_arena.alloc<float>(n + 1);
+		if (!ElevateBezier(points.x.data(), points.y.data(), n, ex, ey))
+			return;
+		points.insert(n - 1, 0.f, 0.f);
+		for (int i = 0; i <= n; i++) {
+			points.x[i] = ex[i];
+			points.y[i] = ey[i];
+		}
+		++points_gen;
+		reindex_points();
+	}
+
+	void set_param_type(int type) {
+		if (param_type == type)
+			return;
+		param_type = type;
+		++param_gen;
+		spline_drag.invalidate();
+	}
+
+	// the points got new indices, the grids pick them by index
+	void reindex_points() {
+		point_grid.clear();
+		for (int i = 0; i < (int)points.size(); i++)
+			point_grid.insert(i, points.x[i], points.y[i]);
+		handle_grid_valid = false;
 	}
 };
 
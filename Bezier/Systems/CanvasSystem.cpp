@@ -13,8 +13,35 @@ using namespace Ubpa;
 
 constexpr int sample_num = 500;
 constexpr float base_tangent_len = 50.f;
-constexpr float t_step = 1.f / (sample_num - 1);
 constexpr float point_radius = 3.f;
+// how far (in pixels) a dragged spline may differ from a full re-solve
+constexpr float drag_tol = 0.05f;
+// how far (in pixels) a Bezier may deviate from its polyline
+constexpr float flatness_tol = 0.25f;
+// samples per span of a B-spline
+constexpr int bspline_samples = 24;
+// range of the control points of the approximation, and of its smoothing
+constexpr int min_fit_points = 4;
+constexpr int max_fit_points = 512;
+constexpr float max_fit_smoothing = 1000.f;
+// range of the weight of a NURBS control point, and the factor of one notch of the mouse wheel
+constexpr float min_weight = 1.f / 64.f;
+constexpr float max_weight = 64.f;
+constexpr float weight_step = 1.25f;
+// zoom range of the mouse wheel, and the zoom of one notch
+constexpr float min_zoom = 1.f / 64.f;
+constexpr float max_zoom = 64.f;
+constexpr float zoom_step = 1.25f;
+// how far (in pixels) the drawn curve may be from its samples, and the segments or spans from
+// which a curve is drawn from its level of detail instead of segment by segment
+constexpr float lod_error = 1.f;
+constexpr int lod_min_segments = 4096;
+// how close to the curve a point snaps to it or the menu inserts on it
+constexpr float snap_radius = 8.f;
+// distance within which two pieces of the curve cross
+constexpr float crossing_tol = 0.05f;
+// seconds between the appends of a file that is still being read, every append refits the curve
+constexpr double import_interval = 0.25;
 constexpr ImU32 line_col = IM_COL32(39, 117, 182, 255);
 constexpr ImU32 edit_line_col = IM_COL32(39, 117, 182, 100);
 constexpr ImU32 normal_point_col = IM_COL32(255, 0, 0, 255);
@@ -22,47 +49,166 @@ constexpr ImU32 select_point_col = IM_COL32(255, 0, 0, 100);
 constexpr ImU32 slope_col = IM_COL32(122, 115, 116, 255);
 constexpr ImU32 select_slope_col = IM_COL32(122, 115, 116, 100);
 
-// four methods to parameterize x, y
-void UniformParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt);
-void ChordalParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt);
-void CentripetalParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt);
-void FoleyParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt);
+// longest polyline handed to ImGui at once, a thick anti-aliased polyline takes 4 vertices
+// per point and has to stay within the 16 bit indices of one draw command
+constexpr int max_polyline = 8192;
 
-// function points for parameterization
-void (*ParamFunc[4])(std::vector<Ubpa::pointf2>&, std::vector<Ubpa::pointf2>&) = {
-		UniformParameterize,ChordalParameterize,CentripetalParameterize,FoleyParameterize
-};
-
-inline void AddLine(const ImVec2& p1, const ImVec2& p2, ImDrawList* draw_list, bool edit_line = false) {
-	draw_list->AddLine(p1, p2, (edit_line ? edit_line_col : line_col), 2.f);
+inline void AddPolyline(const ImVec2* points, int n, ImDrawList* draw_list, bool edit_line = false) {
+	draw_list->AddPolyline(points, n, (edit_line ? edit_line_col : line_col), false, 2.f);
 }
 
-//void draw(std::vector<Ubpa::pointf2>&, CanvasData*, ImDrawList*, const ImVec2&, bool edit_flag = false, bool with_slope = false);
-void draw(std::vector<Ubpa::pointf2>& points, std::vector<Ubpa::pointf2>& ltangent, std::vector<Ubpa::pointf2>& rtangent,
-	CanvasData*, ImDrawList*, const ImVec2&, int edit_flag = 0, bool with_slope = false);
-void drawWithBezier(std::vector<Ubpa::pointf2>& points, std::vector<Ubpa::pointf2>& ltangent,
-	std::vector<Ubpa::pointf2>& rtangent, CanvasData*, ImDrawList*, const ImVec2&, int edit_flag = 0);
+// polyline through x, y split into pieces ImGui can take
+void drawPolyline(const float* x, const float* y, int n, FrameArena&, ImDrawList*, const ImVec2&, float zoom, int edit_flag = 0);
+// draw tangent lines and points, the handles of knot k are replaced by lt and rt
+void drawTangents(CanvasData*, ImDrawList*, const ImVec2&, int edit_flag = 0,
+	int k = -1, const Ubpa::pointf2& lt = Ubpa::pointf2(), const Ubpa::pointf2& rt = Ubpa::pointf2());
+// the curve of the fitting type from its level of detail once it is long, otherwise segment by
+// segment. The segments of a spline covered by the patches at patch are drawn from them instead.
+void drawCurve(CanvasData*, ImDrawList*, const ImVec2&, int edit_flag = 0, const SegmentPatch* patch = nullptr, int patches = 1);
+// the level of lod that is finer than a pixel where it meets the clip rect, with the m edits
+void drawLod(const PolylineLod& lod, const PolylineEdit* edits, int m, FrameArena&, ImDrawList*, const ImVec2&, float zoom, int edit_flag = 0);
+// only the segments inside the clip rect of draw_list are evaluated and drawn, the segments
+// covered by the patches at patch are drawn from them instead
+void drawSamples(SplineCache& s, FrameArena&, ImDrawList*, const ImVec2&, float zoom, int edit_flag = 0, const SegmentPatch* patch = nullptr, int patches = 1);
+// the spans of a B-spline inside the clip rect, and its control polygon
+void drawBSpline(const BSplineCache& s, FrameArena&, ImDrawList*, const ImVec2&, float zoom, int edit_flag = 0);
+void drawControlPolygon(const PointStore& points, ImDrawList*, const ImVec2&, float zoom);
+void drawBezierCurve(const float* x, const float* y, int n, FrameArena&, ImDrawList*, const ImVec2&, float zoom, int edit_flag = 0);
+// previews of one edited point or handle, drawn from the cached curve with the few
+// segments around the edit overlaid so that nothing is copied
+void drawSplineDrag(CanvasData*, const Ubpa::pointf2& p, ImDrawList*, const ImVec2&);
+void drawBezierDrag(CanvasData*, const Ubpa::pointf2& p, ImDrawList*, const ImVec2&);
+void drawBSplineDrag(CanvasData*, const Ubpa::pointf2& p, ImDrawList*, const ImVec2&);
+void drawBezierCurveDrag(CanvasData*, const Ubpa::pointf2& p, ImDrawList*, const ImVec2&);
+void drawLocalSplineDrag(CanvasData*, const Ubpa::pointf2& p, ImDrawList*, const ImVec2&);
+void drawTangentPreview(CanvasData*, int k, const Ubpa::pointf2& lt, const Ubpa::pointf2& rt, ImDrawList*, const ImVec2&);
+
+// sample the curves without drawing
+void fitSpline(SplineCache& s, CanvasData*, bool with_slope);
+void fitBezier(SplineCache& s, PointStore& points);
+
+// refit data->curve_cache only if one of its inputs changed
+void updateCurveCache(CanvasData* data, bool with_slope);
+void updateBSpline(CanvasData* data);
+void updateFit(CanvasData* data);
+void updateLocalSpline(CanvasData* data);
 
-void CubicSpline(std::vector<Ubpa::pointf2>&, std::vector<Ubpa::pointf2>&, std::vector<Slope>&, bool);
-void SlopeSpline(std::vector<Ubpa::pointf2>&, std::vector<Ubpa::pointf2>&, std::vector<Slope>&);
+// the hierarchy over the drawn curve in the cache, built if it is not, null if nothing is drawn
+const CurveBvh* curveBvh(CanvasData* data);
+// the drawn curve in the cache simplified for every zoom, built if it is not, null if it is too
+// short to need one or nothing is drawn
+const PolylineLod* curveLod(CanvasData* data);
+// segments first..last of s as one patch of their own samples, evaluated where they have none
+SegmentPatch samplesPatch(SplineCache& s, int first, int last, FrameArena& arena);
+// the point of the drawn curve nearest to p within max_dist
+bool nearestOnCurve(CanvasData* data, const Ubpa::pointf2& p, float max_dist, CurveHit& hit);
+// mark where the drawn curve crosses itself
+void drawCrossings(CanvasData* data, ImDrawList* draw_list, const ImVec2& origin);
 
 void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 	schedule.RegisterCommand([](Ubpa::UECS::World* w) {
 		auto data = w->entityMngr.GetSingleton<CanvasData>();
 		if (!data)
 			return;
+		data->frame_arena.reset();
 
 		if (ImGui::Begin("Canvas")) {
 			ImGui::Checkbox("Enable grid", &data->opt_enable_grid);
 			ImGui::Checkbox("Enable context menu", &data->opt_enable_context_menu);
+			ImGui::SameLine();
+			ImGui::Checkbox("Show crossings", &data->opt_show_crossings);
 			// ImGui::Text("Mouse Left: drag to add lines,\nMouse Right: drag to scroll, click for context menu.");
-			ImGui::Text("Mouse Left: drag to add points,\nMouse Right: drag to scroll, click for context menu.");
+			ImGui::Text("Mouse Left: drag to add points,\nMouse Right: drag to scroll, click for context menu,\nMouse Wheel: zoom,\nShift: hold a moved point on the curve.");
 
 			if (ImGui::RadioButton("Cubic Spline ", data->fitting_type == 0))
 				data->fitting_type = 0;
 			ImGui::SameLine();
 			if (ImGui::RadioButton("Cubic Bezier ", data->fitting_type == 1))
 				data->fitting_type = 1;
+			ImGui::SameLine();
+			if (ImGui::RadioButton("B-spline ", data->fitting_type == 2))
+				data->fitting_type = 2;
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Bezier curve ", data->fitting_type == 3))
+				data->fitting_type = 3;
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Approximation ", data->fitting_type == 4))
+				data->fitting_type = 4;
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Catmull-Rom ", data->fitting_type == 5))
+				data->fitting_type = 5;
+			if (data->fitting_type == 3 && data->points.size() > bezier_max_degree + 1) {
+				ImGui::SameLine();
+				ImGui::Text("takes at most %d points", bezier_max_degree + 1);
+			}
+			if (data->fitting_type == 2) {
+				ImGui::SameLine();
+				ImGui::SliderInt("Degree", &data->degree, bspline_min_degree, bspline_max_degree);
+			}
+			if (data->fitting_type == 4) {
+				ImGui::SliderInt("Control points", &data->fit_control_points, min_fit_points, max_fit_points);
+				ImGui::SliderFloat("Smoothing", &data->fit_smoothing, 0.f, max_fit_smoothing, "%.3g");
+			}
+			if (data->fitting_type == 5) {
+				ImGui::SliderFloat("Tension", &data->shape.tension, -1.f, 1.f);
+				ImGui::SliderFloat("Bias", &data->shape.bias, -1.f, 1.f);
+				ImGui::SliderFloat("Continuity", &data->shape.continuity, -1.f, 1.f);
+			}
+			if (data->fitting_type == 0 || data->fitting_type == 5) {
+				ImGui::SameLine();
+				bool closed = data->closed;
+				if (ImGui::Checkbox("Closed", &closed))
+					data->set_closed(closed);
+			}
+
+			const char* param_names[4] = { "Uniform ", "Chordal ", "Centripetal ", "Foley " };
+			for (int i = 0; i < 4; i++) {
+				if (i > 0) ImGui::SameLine();
+				if (ImGui::RadioButton(param_names[i], data->param_type == i))
+					data->set_param_type(i);
+			}
+
+			// CSV, binary float pairs or SVG polylines, by the extension
+			ImGui::InputText("##import_path", data->import_path, sizeof(data->import_path));
+			ImGui::SameLine();
+			if (!data->import_job) {
+				if (ImGui::Button("Load points")) {
+					auto job = std::make_shared<PointImportJob>();
+					data->import_failed = !job->start(data->import_path, PointFormatOf(data->import_path));
+					if (!data->import_failed) {
+						data->import_job = std::move(job);
+						data->import_time = ImGui::GetTime();
+						// the point that follows the mouse is not one of the file
+						if (data->adding_last_point && data->points.size() > 0)
+							data->pop_back();
+						data->adding_last_point = false;
+						data->enable_add_point = false;
+					}
+				}
+				if (data->import_failed) {
+					ImGui::SameLine();
+					ImGui::Text("cannot read the file");
+				}
+			}
+			else {
+				// the points staged before the job finished are the last ones, until then they are
+				// taken a few times a second so that the curve is not refit every frame
+				bool finished = data->import_job->finished();
+				if (finished || ImGui::GetTime() - data->import_time >= import_interval) {
+					data->import_time = ImGui::GetTime();
+					data->import_x.clear();
+					data->import_y.clear();
+					size_t n = data->import_job->take(data->import_x, data->import_y);
+					if (n > 0)
+						data->append(data->import_x.data(), data->import_y.data(), n);
+				}
+				ImGui::ProgressBar(data->import_job->progress(), ImVec2(160.f, 0.f));
+				ImGui::SameLine();
+				if (ImGui::Button("Cancel"))
+					data->import_job->cancel();
+				if (finished)
+					data->import_job.reset();
+			}
 
 			// Typically you would use a BeginChild()/EndChild() pair to benefit from a clipping region + own scrolling.
 			// Here we demonstrate that this can be replaced by simple offsetting + custom drawing + PushClipRect/PopClipRect() calls.
@@ -94,8 +240,22 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 			ImGui::InvisibleButton("canvas", canvas_sz, ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonRight);
 			const bool is_hovered = ImGui::IsItemHovered(); // Hovered
 			const bool is_active = ImGui::IsItemActive();   // Held
+
+			// Zoom about the mouse, the point under it stays where it is. Over a point of a NURBS
+			// curve the wheel weighs that point instead.
+			if (is_hovered && io.MouseWheel != 0.f) {
+				float mx = io.MousePos.x - canvas_p0.x, my = io.MousePos.y - canvas_p0.y;
+				pointf2 p((mx - data->scrolling[0]) / data->zoom, (my - data->scrolling[1]) / data->zoom);
+				if (data->fitting_type != 2 || data->pick_point(p, point_radius / data->zoom) == -1) {
+					float zoom = std::clamp(data->zoom * std::pow(zoom_step, io.MouseWheel), min_zoom, max_zoom);
+					data->scrolling[0] = mx - (mx - data->scrolling[0]) / data->zoom * zoom;
+					data->scrolling[1] = my - (my - data->scrolling[1]) / data->zoom * zoom;
+					data->zoom = zoom;
+				}
+			}
+			const float zoom = data->zoom;
 			const ImVec2 origin(canvas_p0.x + data->scrolling[0], canvas_p0.y + data->scrolling[1]); // Lock scrolled origin
-			const pointf2 mouse_pos_in_canvas(io.MousePos.x - origin.x, io.MousePos.y - origin.y);
+			const pointf2 mouse_pos_in_canvas((io.MousePos.x - origin.x) / zoom, (io.MousePos.y - origin.y) / zoom);
 
 			// Add first and second point
 
@@ -119,56 +279,78 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 					data->enable_add_point = false;
 					data->adding_last_point = false;
 				}
-				if (data->enable_add_point) {
+				// the wheel weighs the point under the mouse of a NURBS curve
+				if (data->fitting_type == 2) {
+					int i = data->pick_point(mouse_pos_in_canvas, point_radius / zoom);
+					if (i != -1) {
+						if (io.MouseWheel != 0.f)
+							data->set_weight(i, std::clamp(data->points.w[i] * std::pow(weight_step, io.MouseWheel), min_weight, max_weight));
+						ImGui::SetTooltip("weight %.3g", data->points.w[i]);
+					}
+				}
+				// no points are added by the mouse while a file is read
+				if (data->enable_add_point && !data->import_job) {
 					change_flag = true;
 					if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
 						data->push_back(mouse_pos_in_canvas);
 					}
+					else if (data->points.size() > 0 && data->adding_last_point) {
+						// the last point follows the mouse, a resting mouse changes nothing
+						data->set_point(data->points.size() - 1, mouse_pos_in_canvas);
+					}
 					else {
-						if (data->points.size() > 0 && data->adding_last_point) data->pop_back();
 						data->adding_last_point = true;
 						data->push_back(mouse_pos_in_canvas);
 					}
 				}
 			}
 
+			// Shift holds a moved point on the curve as it was before the move
+			pointf2 move_pos = mouse_pos_in_canvas;
+			if (data->enable_move_point && io.KeyShift) {
+				CurveHit hit;
+				if (nearestOnCurve(data, mouse_pos_in_canvas, snap_radius / zoom, hit)) {
+					move_pos = pointf2(hit.x, hit.y);
+					draw_list->AddCircle(ImVec2(origin.x + zoom * hit.x, origin.y + zoom * hit.y), snap_radius, select_point_col);
+				}
+			}
+
 			if (data->edit_point != 0) {
 				if (!data->enable_move_point) {
-					data->editing_index = -1;
-					for (int i = 0; i < data->points.size(); i++) {
-						if (std::abs(data->points[i][0] - mouse_pos_in_canvas[0]) < point_radius
-							&& std::abs(data->points[i][1] - mouse_pos_in_canvas[1]) < point_radius) {
-							data->editing_index = i;
-							break;
-						}
-					}
+					data->editing_index = data->pick_point(mouse_pos_in_canvas, point_radius / zoom);
 				}
 
 				if (data->editing_index != -1) {
 					if (data->enable_move_point) {
-						draw_list->AddCircleFilled(ImVec2(origin.x + mouse_pos_in_canvas[0], origin.y + mouse_pos_in_canvas[1]), point_radius, select_point_col);
-						std::vector<Ubpa::pointf2> temp_p = data->points;
-						temp_p[data->editing_index] = mouse_pos_in_canvas;
+						draw_list->AddCircleFilled(ImVec2(origin.x + zoom * move_pos[0], origin.y + zoom * move_pos[1]), point_radius, select_point_col);
 						if (data->fitting_type == 0) {
-							draw(temp_p, data->ltangent, data->rtangent, data, draw_list, origin, 1);
+							drawSplineDrag(data, move_pos, draw_list, origin);
 						}
 						else if (data->fitting_type == 1) {
-							std::vector<Ubpa::pointf2> temp_lt = data->ltangent;
-							std::vector<Ubpa::pointf2> temp_rt = data->rtangent;
-							drawWithBezier(temp_p, temp_lt, temp_rt, data, draw_list, origin, 1);
+							drawBezierDrag(data, move_pos, draw_list, origin);
+						}
+						else if (data->fitting_type == 2) {
+							drawBSplineDrag(data, move_pos, draw_list, origin);
+						}
+						else if (data->fitting_type == 3) {
+							drawBezierCurveDrag(data, move_pos, draw_list, origin);
+						}
+						else if (data->fitting_type == 5) {
+							drawLocalSplineDrag(data, move_pos, draw_list, origin);
 						}
 						if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
-							data->points[data->editing_index] = mouse_pos_in_canvas;
+							data->set_point(data->editing_index, move_pos);
 							data->editing_index = -1;
 							data->enable_move_point = false;
 							change_flag = true;
 						}
 					}
 					else {
-						draw_list->AddCircleFilled(ImVec2(origin.x + data->points[data->editing_index][0], origin.y + data->points[data->editing_index][1]), point_radius + 2.f, select_point_col);
+						draw_list->AddCircleFilled(ImVec2(origin.x + zoom * data->points.x[data->editing_index], origin.y + zoom * data->points.y[data->editing_index]), point_radius + 2.f, select_point_col);
 
 						if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
 							data->enable_move_point = true;
+							data->spline_drag.invalidate();
 							// spdlog::info("c3:{}", data->points.size());
 						}
 						else data->editing_index = -1;
@@ -177,37 +359,24 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 				// G0
 				if (data->edit_point == 2) {
 					if (!data->enable_move_tan) {
-						data->editing_tan_index = 0;
-						for (int i = 0; i < data->points.size(); i++) {
-							if (std::abs(data->ltangent[i][0] - mouse_pos_in_canvas[0]) < point_radius
-								&& std::abs(data->ltangent[i][1] - mouse_pos_in_canvas[1]) < point_radius) {
-								data->editing_tan_index = -(i + 1);
-								break;
-							}
-							if (std::abs(data->rtangent[i][0] - mouse_pos_in_canvas[0]) < point_radius
-								&& std::abs(data->rtangent[i][1] - mouse_pos_in_canvas[1]) < point_radius) {
-								data->editing_tan_index = i + 1;
-								break;
-							}
-						}
+						data->editing_tan_index = data->pick_tangent(mouse_pos_in_canvas, point_radius / zoom);
 					}
 					if (data->editing_tan_index < 0) {
 						//spdlog::info("{} {}", -1 - data->editing_tan_index, data->ltangent.size());
 						if (data->enable_move_tan) {
-							draw_list->AddCircleFilled(ImVec2(origin.x + mouse_pos_in_canvas[0], origin.y + mouse_pos_in_canvas[1]), point_radius, select_point_col);
-							std::vector<Ubpa::pointf2> temp_lt = data->ltangent;
-							temp_lt[-1 - data->editing_tan_index] = mouse_pos_in_canvas;
-							draw(data->points, temp_lt, data->rtangent, data, draw_list, origin, 2, true);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * mouse_pos_in_canvas[0], origin.y + zoom * mouse_pos_in_canvas[1]), point_radius, select_point_col);
+							drawTangentPreview(data, -1 - data->editing_tan_index, mouse_pos_in_canvas,
+								data->rtangent(-1 - data->editing_tan_index), draw_list, origin);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
-								data->ltangent[-1 - data->editing_tan_index] = mouse_pos_in_canvas;
+								data->set_ltangent(-1 - data->editing_tan_index, mouse_pos_in_canvas);
 								data->editing_tan_index = 0;
 								data->enable_move_tan = false;
 								// change_flag = true;
 							}
 						}
 						else {
-							draw_list->AddCircleFilled(ImVec2(origin.x + data->ltangent[-1 - data->editing_tan_index][0], origin.y + data->ltangent[-1 - data->editing_tan_index][1]), point_radius + 2.f, select_point_col);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * data->points.lx[-1 - data->editing_tan_index], origin.y + zoom * data->points.ly[-1 - data->editing_tan_index]), point_radius + 2.f, select_point_col);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
 								data->enable_move_tan = true;
@@ -219,20 +388,19 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 					if (data->editing_tan_index > 0) {
 						//spdlog::info("{} {}", -1 + data->editing_tan_index, data->rtangent.size());
 						if (data->enable_move_tan) {
-							draw_list->AddCircleFilled(ImVec2(origin.x + mouse_pos_in_canvas[0], origin.y + mouse_pos_in_canvas[1]), point_radius, select_point_col);
-							std::vector<Ubpa::pointf2> temp_rt = data->rtangent;
-							temp_rt[data->editing_tan_index - 1] = mouse_pos_in_canvas;
-							draw(data->points, data->ltangent, temp_rt, data, draw_list, origin, 2, true);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * mouse_pos_in_canvas[0], origin.y + zoom * mouse_pos_in_canvas[1]), point_radius, select_point_col);
+							drawTangentPreview(data, data->editing_tan_index - 1, data->ltangent(data->editing_tan_index - 1),
+								mouse_pos_in_canvas, draw_list, origin);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
-								data->rtangent[data->editing_tan_index - 1] = mouse_pos_in_canvas;
+								data->set_rtangent(data->editing_tan_index - 1, mouse_pos_in_canvas);
 								data->editing_tan_index = 0;
 								data->enable_move_tan = false;
 								// change_flag = true;
 							}
 						}
 						else {
-							draw_list->AddCircleFilled(ImVec2(origin.x + data->rtangent[data->editing_tan_index - 1][0], origin.y + data->rtangent[data->editing_tan_index - 1][1]), point_radius + 2.f, select_point_col);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * data->points.rx[data->editing_tan_index - 1], origin.y + zoom * data->points.ry[data->editing_tan_index - 1]), point_radius + 2.f, select_point_col);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
 								data->enable_move_tan = true;
@@ -244,46 +412,30 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 				// G1
 				if (data->edit_point == 3) {
 					if (!data->enable_move_tan) {
-						data->editing_tan_index = 0;
-						for (int i = 0; i < data->points.size(); i++) {
-							if (std::abs(data->ltangent[i][0] - mouse_pos_in_canvas[0]) < point_radius
-								&& std::abs(data->ltangent[i][1] - mouse_pos_in_canvas[1]) < point_radius) {
-								data->editing_tan_index = -(i + 1);
-								break;
-							}
-							if (std::abs(data->rtangent[i][0] - mouse_pos_in_canvas[0]) < point_radius
-								&& std::abs(data->rtangent[i][1] - mouse_pos_in_canvas[1]) < point_radius) {
-								data->editing_tan_index = i + 1;
-								break;
-							}
-						}
+						data->editing_tan_index = data->pick_tangent(mouse_pos_in_canvas, point_radius / zoom);
 					}
 					if (data->editing_tan_index < 0) {
 						//spdlog::info("{} {}", -1 - data->editing_tan_index, data->ltangent.size());
 						if (data->enable_move_tan) {
-							draw_list->AddCircleFilled(ImVec2(origin.x + mouse_pos_in_canvas[0], origin.y + mouse_pos_in_canvas[1]), point_radius, select_point_col);
-							std::vector<Ubpa::pointf2> temp_lt = data->ltangent;
-							std::vector<Ubpa::pointf2> temp_rt = data->rtangent;
-							temp_lt[-1 - data->editing_tan_index] = mouse_pos_in_canvas;
-							float ratio_distance = data->points[-1 - data->editing_tan_index].distance(temp_rt[-1 - data->editing_tan_index]) /
-								data->points[-1 - data->editing_tan_index].distance(mouse_pos_in_canvas);
-							float x = mouse_pos_in_canvas[0] - data->points[-1 - data->editing_tan_index][0];
-							x = data->points[-1 - data->editing_tan_index][0] - x * ratio_distance;
-							float y = mouse_pos_in_canvas[1] - data->points[-1 - data->editing_tan_index][1];
-							y = data->points[-1 - data->editing_tan_index][1] - y * ratio_distance;
-							temp_rt[-1 - data->editing_tan_index] = Ubpa::pointf2(x, y);
-							draw(data->points, temp_lt, temp_rt, data, draw_list, origin, 2, true);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * mouse_pos_in_canvas[0], origin.y + zoom * mouse_pos_in_canvas[1]), point_radius, select_point_col);
+							float ratio_distance = data->point(-1 - data->editing_tan_index).distance(data->rtangent(-1 - data->editing_tan_index)) /
+								data->point(-1 - data->editing_tan_index).distance(mouse_pos_in_canvas);
+							float x = mouse_pos_in_canvas[0] - data->points.x[-1 - data->editing_tan_index];
+							x = data->points.x[-1 - data->editing_tan_index] - x * ratio_distance;
+							float y = mouse_pos_in_canvas[1] - data->points.y[-1 - data->editing_tan_index];
+							y = data->points.y[-1 - data->editing_tan_index] - y * ratio_distance;
+							drawTangentPreview(data, -1 - data->editing_tan_index, mouse_pos_in_canvas, Ubpa::pointf2(x, y), draw_list, origin);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
-								data->ltangent[-1 - data->editing_tan_index] = mouse_pos_in_canvas;
-								data->rtangent[-1 - data->editing_tan_index] = Ubpa::pointf2(x, y);
+								data->set_ltangent(-1 - data->editing_tan_index, mouse_pos_in_canvas);
+								data->set_rtangent(-1 - data->editing_tan_index, Ubpa::pointf2(x, y));
 								data->editing_tan_index = 0;
 								data->enable_move_tan = false;
 								// change_flag = true;
 							}
 						}
 						else {
-							draw_list->AddCircleFilled(ImVec2(origin.x + data->ltangent[-1 - data->editing_tan_index][0], origin.y + data->ltangent[-1 - data->editing_tan_index][1]), point_radius + 2.f, select_point_col);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * data->points.lx[-1 - data->editing_tan_index], origin.y + zoom * data->points.ly[-1 - data->editing_tan_index]), point_radius + 2.f, select_point_col);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
 								data->enable_move_tan = true;
@@ -295,29 +447,25 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 					if (data->editing_tan_index > 0) {
 						//spdlog::info("{} {}", -1 + data->editing_tan_index, data->rtangent.size());
 						if (data->enable_move_tan) {
-							draw_list->AddCircleFilled(ImVec2(origin.x + mouse_pos_in_canvas[0], origin.y + mouse_pos_in_canvas[1]), point_radius, select_point_col);
-							std::vector<Ubpa::pointf2> temp_lt = data->ltangent;
-							std::vector<Ubpa::pointf2> temp_rt = data->rtangent;
-							temp_rt[data->editing_tan_index - 1] = mouse_pos_in_canvas;
-							float ratio_distance = data->points[data->editing_tan_index - 1].distance(temp_lt[data->editing_tan_index - 1]) /
-								data->points[data->editing_tan_index - 1].distance(mouse_pos_in_canvas);
-							float x = mouse_pos_in_canvas[0] - data->points[data->editing_tan_index - 1][0];
-							x = data->points[data->editing_tan_index - 1][0] - x * ratio_distance;
-							float y = mouse_pos_in_canvas[1] - data->points[data->editing_tan_index - 1][1];
-							y = data->points[data->editing_tan_index - 1][1] - y * ratio_distance;
-							temp_lt[data->editing_tan_index - 1] = Ubpa::pointf2(x, y);
-							draw(data->points, temp_lt, temp_rt, data, draw_list, origin, 2, true);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * mouse_pos_in_canvas[0], origin.y + zoom * mouse_pos_in_canvas[1]), point_radius, select_point_col);
+							float ratio_distance = data->point(data->editing_tan_index - 1).distance(data->ltangent(data->editing_tan_index - 1)) /
+								data->point(data->editing_tan_index - 1).distance(mouse_pos_in_canvas);
+							float x = mouse_pos_in_canvas[0] - data->points.x[data->editing_tan_index - 1];
+							x = data->points.x[data->editing_tan_index - 1] - x * ratio_distance;
+							float y = mouse_pos_in_canvas[1] - data->points.y[data->editing_tan_index - 1];
+							y = data->points.y[data->editing_tan_index - 1] - y * ratio_distance;
+							drawTangentPreview(data, data->editing_tan_index - 1, Ubpa::pointf2(x, y), mouse_pos_in_canvas, draw_list, origin);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
-								data->ltangent[data->editing_tan_index - 1] = Ubpa::pointf2(x, y);
-								data->rtangent[data->editing_tan_index - 1] = mouse_pos_in_canvas;
+								data->set_ltangent(data->editing_tan_index - 1, Ubpa::pointf2(x, y));
+								data->set_rtangent(data->editing_tan_index - 1, mouse_pos_in_canvas);
 								data->editing_tan_index = 0;
 								data->enable_move_tan = false;
 								// change_flag = true;
 							}
 						}
 						else {
-							draw_list->AddCircleFilled(ImVec2(origin.x + data->rtangent[data->editing_tan_index - 1][0], origin.y + data->rtangent[data->editing_tan_index - 1][1]), point_radius + 2.f, select_point_col);
+							draw_list->AddCircleFilled(ImVec2(origin.x + zoom * data->points.rx[data->editing_tan_index - 1], origin.y + zoom * data->points.ry[data->editing_tan_index - 1]), point_radius + 2.f, select_point_col);
 
 							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
 								data->enable_move_tan = true;
@@ -371,11 +519,23 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 					data->enable_add_point = true;
 					data->edit_point = 0;
 				}
+				// the point of the curve where the menu was opened
+				ImVec2 menu_pos = ImGui::GetMousePosOnOpeningCurrentPopup();
+				CurveHit hit;
+				bool on_curve = data->points.size() > 1
+					&& nearestOnCurve(data, pointf2((menu_pos.x - origin.x) / zoom, (menu_pos.y - origin.y) / zoom), snap_radius / zoom, hit);
+				if ((data->fitting_type == 0 || data->fitting_type == 1 || data->fitting_type == 5) && ImGui::MenuItem("Insert point here", NULL, false, on_curve))
+					data->insert(hit.segment + 1, pointf2(hit.x, hit.y));
+				if (data->fitting_type == 2 && ImGui::MenuItem("Insert knot here", NULL, false, on_curve))
+					data->insert_knot(SampleParameter(data->curve_cache.bspline, hit.segment, hit.t));
+				if (data->fitting_type == 3 && ImGui::MenuItem("Elevate degree", NULL, false,
+					data->points.size() >= 2 && data->points.size() <= bezier_max_degree))
+					data->elevate_degree();
 				if (!data->enable_add_point) {
 					if (data->edit_point == 0) {
 						if (ImGui::MenuItem("Edit Points' position", NULL, false, data->points.size() > 0))
 							data->edit_point = 1;
-						if (data->fitting_type == 0) {
+						if (data->fitting_type == 0 && !data->closed) {
 							if (ImGui::MenuItem("Edit Points' slope (G0)", NULL, false))
 								data->edit_point = 2;
 							if (ImGui::MenuItem("Edit Points' slope (G1)", NULL, false))
@@ -397,7 +557,10 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 			draw_list->PushClipRect(canvas_p0, canvas_p1, true);
 			if (data->opt_enable_grid)
 			{
-				const float GRID_STEP = 64.0f;
+				// the grid is in canvas units, in steps of 4 that keep the lines 16 to 64 pixels apart
+				float GRID_STEP = 64.0f * zoom;
+				while (GRID_STEP < 16.f) GRID_STEP *= 4.f;
+				while (GRID_STEP > 64.f) GRID_STEP /= 4.f;
 				for (float x = fmodf(data->scrolling[0], GRID_STEP); x < canvas_sz.x; x += GRID_STEP)
 					draw_list->AddLine(ImVec2(canvas_p0.x + x, canvas_p0.y), ImVec2(canvas_p0.x + x, canvas_p1.y), IM_COL32(200, 200, 200, 40));
 				for (float y = fmodf(data->scrolling[1], GRID_STEP); y < canvas_sz.y; y += GRID_STEP)
@@ -407,21 +570,30 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 			// Draw points
 
 			/*for (int n = 0; n < data->points.size(); n += 2)
-				draw_list->AddLine(ImVec2(origin.x + data->points[n][0], origin.y + data->points[n][1]), ImVec2(origin.x + data->points[n + 1][0], origin.y + data->points[n + 1][1]), IM_COL32(255, 255, 0, 255), 2.0f);
+				draw_list->AddLine(ImVec2(origin.x + data->points.x[n], origin.y + data->points.y[n]), ImVec2(origin.x + data->points.x[n + 1], origin.y + data->points.y[n + 1]), IM_COL32(255, 255, 0, 255), 2.0f);
 			draw_list->PopClipRect();*/
-			for (int n = 0; n < data->points.size(); n++)
-				draw_list->AddCircleFilled(ImVec2(origin.x + data->points[n][0], origin.y + data->points[n][1]), point_radius, normal_point_col);
+			// only the points inside the canvas, a long trace has far more of them than pixels
+			for (int n = 0; n < data->points.size(); n++) {
+				ImVec2 p(origin.x + zoom * data->points.x[n], origin.y + zoom * data->points.y[n]);
+				if (p.x >= canvas_p0.x - point_radius && p.x <= canvas_p1.x + point_radius
+					&& p.y >= canvas_p0.y - point_radius && p.y <= canvas_p1.y + point_radius)
+					draw_list->AddCircleFilled(p, point_radius, normal_point_col);
+			}
 
 
 			if (data->points.size() < 2) data->enable_add_point = true, data->edit_point = 0;
 			else {
-				// void (*ParamFunc)(std::vector<Ubpa::pointf2>&, std::vector<Ubpa::pointf2>&) = UniformParameterize;
-				if (data->fitting_type == 0) {
-					draw(data->points, data->ltangent, data->rtangent, data, draw_list, origin, false, !change_flag);
-				}
-				else if (data->fitting_type == 1) {
-					drawWithBezier(data->points, data->ltangent, data->rtangent, data, draw_list, origin, false);
-				}
+				updateCurveCache(data, !change_flag);
+				if (data->fitting_type == 0)
+					drawTangents(data, draw_list, origin);
+				if (data->fitting_type == 2 || data->fitting_type == 3)
+					drawControlPolygon(data->points, draw_list, origin, zoom);
+				if (data->fitting_type == 3)
+					drawBezierCurve(data->points.x.data(), data->points.y.data(), (int)data->points.size(), data->frame_arena, draw_list, origin, zoom);
+				else
+					drawCurve(data, draw_list, origin);
+				if (data->opt_show_crossings)
+					drawCrossings(data, draw_list, origin);
 			}
 
 			draw_list->PopClipRect();
@@ -431,328 +603,717 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 	});
 }
 
-constexpr int Bezier_num = 100;
-void DeCastljau(std::vector<Ubpa::pointf2>& ret, Ubpa::pointf2* p) {
-	const float step = 1.f / (Bezier_num - 1);
-	for (float t = 0.f; t <= 1.f; t += step) {
-		float x = std::pow((1 - t), 3) * p[0][0] + 3 * t * (1 - t) * (1 - t) * p[1][0] + 3 * t * t * (1 - t) * p[2][0] + pow(t, 3) * p[3][0];
-		float y = std::pow((1 - t), 3) * p[0][1] + 3 * t * (1 - t) * (1 - t) * p[1][1] + 3 * t * t * (1 - t) * p[2][1] + pow(t, 3) * p[3][1];
-		ret.push_back(Ubpa::pointf2(x, y));
+void updateCurveCache(CanvasData* data, bool with_slope) {
+	if (data->fitting_type == 2) {
+		updateBSpline(data);
+		return;
 	}
-}
-
-void drawWithBezier(std::vector<Ubpa::pointf2>& points,
-	std::vector<Ubpa::pointf2>& ltangent, std::vector<Ubpa::pointf2>& rtangent,
-	CanvasData* data, ImDrawList* draw_list, const ImVec2& origin, int edit_flag) {
-	size_t n = points.size();
-	if (n == 2) {
-		AddLine(ImVec2(origin.x + points[0][0], origin.y + points[0][1]),
-			ImVec2(origin.x + points[1][0], origin.y + points[1][1]), draw_list, edit_flag);
+	if (data->fitting_type == 4) {
+		updateFit(data);
 		return;
 	}
-	for (int i = 1; i < n - 1; ++i) {
-		float dx = points[i + 1][0] - points[i - 1][0];
-		float dy = points[i + 1][1] - points[i - 1][1];
-		rtangent[i] = Ubpa::pointf2(points[i][0] + dx / 6.f, points[i][1] + dy / 6.f);
-		ltangent[i] = Ubpa::pointf2(points[i][0] - dx / 6.f, points[i][1] - dy / 6.f);
-	}
-	rtangent[0] = Ubpa::pointf2(points[0][0] + (points[1][0] - points[2][0]) / 6.f, points[0][1] + (points[1][1] - points[2][1]) / 6.f);
-	ltangent[n - 1] = Ubpa::pointf2(points[n - 1][0] - (points[n - 2][0] - points[n - 3][0]) / 6.f, points[n - 1][1] - (points[n - 2][1] - points[n - 3][1]) / 6.f);
-	for (int i = 0; i < n - 1; ++i) {
-		Ubpa::pointf2 control_points[4] = { points[i], rtangent[i], ltangent[i + 1], points[i + 1] };
-		std::vector<Ubpa::pointf2> p;
-		DeCastljau(p, control_points);
-		for (int j = 0; j < p.size() - 1; ++j) {
-			AddLine(ImVec2(origin.x + p[j][0], origin.y + p[j][1]),
-				ImVec2(origin.x + p[j + 1][0], origin.y + p[j + 1][1]),
-				draw_list, edit_flag);
-		}
+	if (data->fitting_type == 5) {
+		updateLocalSpline(data);
+		return;
 	}
-}
+	// one Bezier curve over all points is sampled as it is drawn
+	if (data->fitting_type == 3)
+		return;
+	CurveCache& cache = data->curve_cache;
+	if (cache.valid
+		&& cache.points_gen == data->points_gen
+		&& cache.tangent_gen == data->tangent_gen
+		&& cache.param_gen == data->param_gen
+		&& cache.fitting_type == data->fitting_type
+		&& (data->fitting_type != 0 || (cache.with_slope == with_slope && cache.closed == data->closed)))
+		return;
+	// the slopes of the other kind of curve are no use, they are solved again
+	if (cache.closed != data->closed)
+		with_slope = false;
 
-void draw(std::vector<Ubpa::pointf2>& points, std::vector<Ubpa::pointf2>& ltangent,
-	std::vector<Ubpa::pointf2>& rtangent, CanvasData* data, ImDrawList* draw_list,
-	const ImVec2& origin, int edit_flag, bool with_slope) {
-	// Parameterize
-	std::vector<Ubpa::pointf2> xt = points;
-	std::vector<Ubpa::pointf2> yt = points;
-	ParamFunc[data->param_type](xt, yt);
-	std::vector<Ubpa::pointf2> x;
-	std::vector<Ubpa::pointf2> y;
-	if (with_slope) {
-		if (!edit_flag) {
-			SlopeSpline(x, xt, data->xk);
-			SlopeSpline(y, yt, data->yk);
-		}
-		else {
-			std::vector<Slope> xk = data->xk;
-			std::vector<Slope> yk = data->yk;
+	if (data->fitting_type == 0) {
+		// edited tangents are the source of the slopes
+		if (with_slope && (data->edit_point == 2 || data->edit_point == 3)) {
 			for (int i = 0; i < data->points.size() - 1; i++) {
-				const ImVec2 p1(origin.x + points[i][0], origin.y + points[i][1]);
-				const ImVec2 p2(origin.x + rtangent[i][0], origin.y + rtangent[i][1]);
-				xk[i].r = rtangent[i][0] - points[i][0];
-				xk[i].r /= data->tangent_ratio[i].r;
-				yk[i].r = rtangent[i][1] - points[i][1];
-				yk[i].r /= data->tangent_ratio[i].r;
+				data->points.kx[i].r = (data->points.rx[i] - data->points.x[i]) / data->points.rratio[i];
+				data->points.ky[i].r = (data->points.ry[i] - data->points.y[i]) / data->points.rratio[i];
 			}
 			for (int i = data->points.size() - 1; i > 0; i--) {
-				const ImVec2 p1(origin.x + points[i][0], origin.y + points[i][1]);
-				const ImVec2 p2(origin.x + ltangent[i][0], origin.y + ltangent[i][1]);
-				xk[i].l = points[i][0] - ltangent[i][0];
-				xk[i].l /= data->tangent_ratio[i].l;
-				yk[i].l = points[i][1] - ltangent[i][1];
-				yk[i].l /= data->tangent_ratio[i].l;
+				data->points.kx[i].l = (data->points.x[i] - data->points.lx[i]) / data->points.lratio[i];
+				data->points.ky[i].l = (data->points.y[i] - data->points.ly[i]) / data->points.lratio[i];
 			}
-			SlopeSpline(x, xt, xk);
-			SlopeSpline(y, yt, yk);
 		}
+		fitSpline(cache.curve, data, with_slope);
 	}
-	else {
-		CubicSpline(x, xt, data->xk, edit_flag);
-		CubicSpline(y, yt, data->yk, edit_flag);
-		if (!edit_flag) {
-			for (int i = 0; i < points.size() - 1; i++) {
-				Ubpa::pointf2 temp = Ubpa::pointf2(data->xk[i].r, data->yk[i].r);
-				data->tangent_ratio[i].r = base_tangent_len / temp.distance(Ubpa::pointf2(0.f, 0.f));
-				data->rtangent[i] = Ubpa::pointf2(data->points[i][0] + data->xk[i].r * data->tangent_ratio[i].r,
-					data->points[i][1] + data->yk[i].r * data->tangent_ratio[i].r);
-			}
-			for (int i = points.size() - 1; i > 0; i--) {
-				Ubpa::pointf2 temp = Ubpa::pointf2(data->xk[i].l, data->yk[i].l);
-				data->tangent_ratio[i].l = base_tangent_len / temp.distance(Ubpa::pointf2(0.f, 0.f));
-				data->ltangent[i] = Ubpa::pointf2(data->points[i][0] - data->xk[i].l * data->tangent_ratio[i].l,
-					data->points[i][1] - data->yk[i].l * data->tangent_ratio[i].l);
+	else if (data->fitting_type == 1) {
+		fitBezier(cache.curve, data->points);
+	}
+
+	// the fit rewrote the handles
+	data->handle_grid_valid = false;
+	cache.changed();
+
+	cache.points_gen = data->points_gen;
+	cache.tangent_gen = data->tangent_gen;
+	cache.param_gen = data->param_gen;
+	cache.fitting_type = data->fitting_type;
+	cache.with_slope = with_slope;
+	cache.closed = data->closed;
+	cache.valid = true;
+}
+
+void updateBSpline(CanvasData* data) {
+	CurveCache& cache = data->curve_cache;
+	BSplineCache& b = cache.bspline;
+	const PointStore& points = data->points;
+	int n = (int)points.size();
+	// the degree drops until there are enough points for one span
+	int degree = std::min(data->degree, n - 1);
+	if (!cache.bspline_valid || cache.bspline_param_gen != data->param_gen || b.degree != degree || b.points() != n) {
+		b.assign(points.x.data(), points.y.data(), points.w.data(), n, degree);
+		BSplineKnots(b, data->param_type);
+		SampleBSpline(b, bspline_samples);
+		cache.changed();
+	}
+	else if (cache.bspline_points_gen != data->points_gen || cache.bspline_dragged) {
+		// a drag only goes back to the curve the hierarchy and the level of detail were built from
+		if (cache.bspline_points_gen != data->points_gen)
+			cache.changed();
+		// the knots stay, every point that moved evaluates its own spans
+		for (int i = 0; i < n; i++) {
+			if (b.x[i] != points.x[i] || b.y[i] != points.y[i] || b.w[i] != points.w[i]) {
+				int first, last;
+				MoveControlPoint(b, i, points.x[i], points.y[i], points.w[i], first, last);
 			}
 		}
 	}
-	std::vector<Ubpa::pointf2> p = y;
-	for (int i = 0; i < p.size(); i++) p[i][0] = x[i][1];
-	// draw tangent lines and points
-	if (data->edit_point == 2 || data->edit_point == 3) {
-		for (int i = 0; i < data->points.size() - 1; i++) {
-			const ImVec2 p1(origin.x + points[i][0], origin.y + points[i][1]);
-			const ImVec2 p2(origin.x + rtangent[i][0], origin.y + rtangent[i][1]);
-			if (!edit_flag) {
-				data->xk[i].r = rtangent[i][0] - points[i][0];
-				data->xk[i].r /= data->tangent_ratio[i].r;
-				data->yk[i].r = rtangent[i][1] - points[i][1];
-				data->yk[i].r /= data->tangent_ratio[i].r;
-				draw_list->AddLine(p1, p2, slope_col, 2.f);
-				draw_list->AddCircleFilled(p2, point_radius, normal_point_col);
-			}
-			else {
-				if (edit_flag == 2) draw_list->AddLine(p1, p2, select_slope_col, 2.f);
-				draw_list->AddCircleFilled(p2, point_radius, select_point_col);
-			}
+	cache.bspline_points_gen = data->points_gen;
+	cache.bspline_param_gen = data->param_gen;
+	cache.bspline_valid = true;
+	cache.bspline_dragged = false;
+}
+
+void updateFit(CanvasData* data) {
+	CurveCache& cache = data->curve_cache;
+	int n = (int)data->points.size();
+	int m = std::max(min_fit_points, std::min(data->fit_control_points, n));
+	float smoothing = std::max(data->fit_smoothing, 0.f);
+	if (cache.fit_valid
+		&& cache.fit_points_gen == data->points_gen
+		&& cache.fit_param_gen == data->param_gen
+		&& cache.fit_control_points == m
+		&& cache.fit_smoothing == smoothing)
+		return;
+	BSplineCache& f = cache.fit;
+	if (!FitBSpline(data->points.x.data(), data->points.y.data(), n, m, smoothing, data->param_type, f, data->frame_arena))
+		f.assign(nullptr, nullptr, nullptr, 0, 3);
+	SampleBSpline(f, bspline_samples);
+	cache.fit_points_gen = data->points_gen;
+	cache.fit_param_gen = data->param_gen;
+	cache.fit_control_points = m;
+	cache.fit_smoothing = smoothing;
+	cache.fit_valid = true;
+	cache.changed();
+}
+
+void updateLocalSpline(CanvasData* data) {
+	CurveCache& cache = data->curve_cache;
+	SplineCache& s = cache.local;
+	const PointStore& points = data->points;
+	int n = (int)points.size();
+	const SplineShape& shape = data->shape;
+	bool same_shape = cache.local_shape.tension == shape.tension
+		&& cache.local_shape.bias == shape.bias
+		&& cache.local_shape.continuity == shape.continuity;
+	// a closed curve repeats its first knot
+	int knots = s.periodic() ? s.knots() - 1 : s.knots();
+	if (!cache.local_valid || cache.local_param_gen != data->param_gen || !same_shape
+		|| cache.local_closed != data->closed || knots != n) {
+		s.closed = data->closed;
+		s.assign(points.x.data(), points.y.data(), n);
+		LocalSpline(s, data->param_type, shape);
+		SampleAdaptive(s, flatness_tol);
+		cache.changed();
+	}
+	else if (cache.local_points_gen != data->points_gen) {
+		cache.changed();
+		int ids[max_local_segments];
+		// a single moved point is known, anything else is found by comparing
+		if (data->moved_gen == data->points_gen && cache.local_points_gen + 1 == data->points_gen) {
+			int k = data->moved_index;
+			MoveLocalKnot(s, data->param_type, shape, k, points.x[k], points.y[k], ids);
 		}
-		for (int i = data->points.size() - 1; i > 0; i--) {
-			const ImVec2 p1(origin.x + points[i][0], origin.y + points[i][1]);
-			const ImVec2 p2(origin.x + ltangent[i][0], origin.y + ltangent[i][1]);
-			if (!edit_flag) {
-				data->xk[i].l = points[i][0] - ltangent[i][0];
-				data->xk[i].l /= data->tangent_ratio[i].l;
-				data->yk[i].l = points[i][1] - ltangent[i][1];
-				data->yk[i].l /= data->tangent_ratio[i].l;
-				draw_list->AddLine(p1, p2, slope_col, 2.f);
-				draw_list->AddCircleFilled(p2, point_radius, normal_point_col);
+		else {
+			for (int i = 0; i < n; i++) {
+				if (s.x[i] != points.x[i] || s.y[i] != points.y[i])
+					MoveLocalKnot(s, data->param_type, shape, i, points.x[i], points.y[i], ids);
 			}
-			else {
-				if (edit_flag == 2) draw_list->AddLine(p1, p2, select_slope_col, 2.f);
-				draw_list->AddCircleFilled(p2, point_radius, select_point_col);
+		}
+	}
+	cache.local_points_gen = data->points_gen;
+	cache.local_param_gen = data->param_gen;
+	cache.local_shape = shape;
+	cache.local_closed = data->closed;
+	cache.local_valid = true;
+}
+
+const CurveBvh* curveBvh(CanvasData* data) {
+	CurveCache& cache = data->curve_cache;
+	if (cache.bvh_type != data->fitting_type) {
+		if (data->fitting_type == 2 || data->fitting_type == 4) {
+			// a drag of the B-spline moved the cached control point, it goes back first
+			updateCurveCache(data, false);
+			const BSplineCache& b = data->fitting_type == 2 ? cache.bspline : cache.fit;
+			if (b.spans() == 0)
+				return nullptr;
+			cache.bvh.buildPolyline(b.sx.data(), b.sy.data(), (int)b.sx.size());
+		}
+		else if (((data->fitting_type == 0 || data->fitting_type == 1) && cache.valid && cache.fitting_type == data->fitting_type)
+			|| (data->fitting_type == 5 && cache.local_valid)) {
+			// the curve as it was drawn, segment i of the hierarchy is segment i of the spline
+			const SplineCache& s = data->fitting_type == 5 ? cache.local : cache.curve;
+			int m = s.segments();
+			float* cx = data->frame_arena.alloc<float>(4 * m);
+			float* cy = data->frame_arena.alloc<float>(4 * m);
+			for (int i = 0; i < m; i++)
+				ControlPoints(s, i, cx + 4 * i, cy + 4 * i);
+			cache.bvh.build(cx, cy, m);
+		}
+		else
+			return nullptr;
+		cache.bvh_type = data->fitting_type;
+		cache.crossings_valid = false;
+	}
+	return &cache.bvh;
+}
+
+const PolylineLod* curveLod(CanvasData* data) {
+	CurveCache& cache = data->curve_cache;
+	if (cache.lod_type != data->fitting_type) {
+		cache.lod.clear();
+		FrameArena& arena = data->frame_arena;
+		// the finest level of detail is just good enough at the largest zoom
+		float min_error = lod_error / max_zoom;
+		if (data->fitting_type == 2 || data->fitting_type == 4) {
+			// a drag of the B-spline moved the cached control point, it goes back first
+			updateCurveCache(data, false);
+			const BSplineCache& b = data->fitting_type == 2 ? cache.bspline : cache.fit;
+			if (b.spans() >= lod_min_segments)
+				cache.lod.build(b.sx.data(), b.sy.data(), (int)b.sx.size(), min_error, arena);
+		}
+		else if (((data->fitting_type == 0 || data->fitting_type == 1) && cache.valid && cache.fitting_type == data->fitting_type)
+			|| (data->fitting_type == 5 && cache.local_valid)) {
+			SplineCache& s = data->fitting_type == 5 ? cache.local : cache.curve;
+			int m = s.segments();
+			if (m >= lod_min_segments) {
+				// the samples of all segments in curve order, closed by the last knot
+				SampleAll(s);
+				std::vector<int>& start = cache.lod_start;
+				start.resize(m + 1);
+				start[0] = 0;
+				for (int i = 0; i < m; i++)
+					start[i + 1] = start[i] + s.count[i];
+				float* px = arena.alloc<float>(start[m] + 1);
+				float* py = arena.alloc<float>(start[m] + 1);
+				for (int i = 0; i < m; i++) {
+					std::copy(s.sx.begin() + s.offset[i], s.sx.begin() + s.offset[i] + s.count[i], px + start[i]);
+					std::copy(s.sy.begin() + s.offset[i], s.sy.begin() + s.offset[i] + s.count[i], py + start[i]);
+				}
+				px[start[m]] = s.x[m];
+				py[start[m]] = s.y[m];
+				cache.lod.build(px, py, start[m] + 1, min_error, arena);
 			}
 		}
+		else
+			return nullptr;
+		cache.lod_type = data->fitting_type;
 	}
-	// draw spline
-	for (int i = 1; i < p.size(); i++) {
-		AddLine(ImVec2(origin.x + p[i - 1][0], origin.y + p[i - 1][1]),
-			ImVec2(origin.x + p[i][0], origin.y + p[i][1]), draw_list, edit_flag);
+	return cache.lod.levels() > 0 ? &cache.lod : nullptr;
+}
+
+bool nearestOnCurve(CanvasData* data, const Ubpa::pointf2& p, float max_dist, CurveHit& hit) {
+	const CurveBvh* bvh = curveBvh(data);
+	return bvh && bvh->nearest(p[0], p[1], max_dist, hit);
+}
+
+void drawCrossings(CanvasData* data, ImDrawList* draw_list, const ImVec2& origin) {
+	const CurveBvh* bvh = curveBvh(data);
+	if (!bvh)
+		return;
+	CurveCache& cache = data->curve_cache;
+	float zoom = data->zoom;
+	if (!cache.crossings_valid) {
+		cache.crossings.clear();
+		SelfIntersections(*bvh, crossing_tol, cache.crossings);
+		cache.crossings_valid = true;
 	}
+	for (const CurveCrossing& c : cache.crossings)
+		draw_list->AddCircle(ImVec2(origin.x + zoom * c.x, origin.y + zoom * c.y), point_radius + 2.f, select_point_col);
 }
 
-inline float h0(const float x0, const float x1, const float x) {
-	return (1.f + 2.f * (x - x0) / (x1 - x0)) * ((x - x1) * (x - x1)) / ((x0 - x1) * (x0 - x1));
+void drawCurve(CanvasData* data, ImDrawList* draw_list, const ImVec2& origin, int edit_flag, const SegmentPatch* patch, int patches) {
+	CurveCache& cache = data->curve_cache;
+	FrameArena& arena = data->frame_arena;
+	float zoom = data->zoom;
+	const PolylineLod* lod = curveLod(data);
+	if (data->fitting_type == 2 || data->fitting_type == 4) {
+		const BSplineCache& b = data->fitting_type == 2 ? cache.bspline : cache.fit;
+		if (lod)
+			drawLod(*lod, nullptr, 0, arena, draw_list, origin, zoom, edit_flag);
+		else if (b.spans() > 0)
+			drawBSpline(b, arena, draw_list, origin, zoom, edit_flag);
+		return;
+	}
+	if (!lod) {
+		drawSamples(data->fitting_type == 5 ? cache.local : cache.curve, arena, draw_list, origin, zoom, edit_flag, patch, patches);
+		return;
+	}
+	// a patch stands in for the samples from the knot of its first segment to the knot after its
+	// last, the patches of a closed curve may run across its end
+	int m = patch ? patches : 0;
+	PolylineEdit* edits = arena.alloc<PolylineEdit>(m);
+	for (int k = 0; k < m; k++) {
+		const SegmentPatch& p = patch[k];
+		edits[k] = { cache.lod_start[p.first], cache.lod_start[p.last + 1], p.x, p.y, p.size };
+	}
+	std::sort(edits, edits + m, [](const PolylineEdit& a, const PolylineEdit& b) { return a.first < b.first; });
+	drawLod(*lod, edits, m, arena, draw_list, origin, zoom, edit_flag);
 }
-inline float h1(const float x0, const float x1, const float x) {
-	return h0(x1, x0, x);
+
+void drawLod(const PolylineLod& lod, const PolylineEdit* edits, int m, FrameArena& arena, ImDrawList* draw_list,
+	const ImVec2& origin, float zoom, int edit_flag) {
+	// clip rect in canvas coordinates, grown by the line width
+	ImVec2 clip_min = draw_list->GetClipRectMin();
+	ImVec2 clip_max = draw_list->GetClipRectMax();
+	float x0 = (clip_min.x - origin.x - 2.f) / zoom, y0 = (clip_min.y - origin.y - 2.f) / zoom;
+	float x1 = (clip_max.x - origin.x + 2.f) / zoom, y1 = (clip_max.y - origin.y + 2.f) / zoom;
+	int l = lod.pick(lod_error / zoom);
+	lod.forEachRun(l, x0, y0, x1, y1, edits, m, arena, [&](const float* x, const float* y, int size) {
+		drawPolyline(x, y, size, arena, draw_list, origin, zoom, edit_flag);
+	});
 }
-inline float H0(const float x0, const float x1, const float x) {
-	return (x - x0) * ((x - x1) * (x - x1)) / ((x0 - x1) * (x0 - x1));
+
+void drawPolyline(const float* x, const float* y, int n, FrameArena& arena, ImDrawList* draw_list,
+	const ImVec2& origin, float zoom, int edit_flag) {
+	ImVec2* run = arena.alloc<ImVec2>(max_polyline);
+	// pieces share their end points
+	for (int first = 0; first < n - 1; first += max_polyline - 1) {
+		int m = std::min(max_polyline, n - first);
+		for (int j = 0; j < m; j++)
+			run[j] = ImVec2(origin.x + zoom * x[first + j], origin.y + zoom * y[first + j]);
+		AddPolyline(run, m, draw_list, edit_flag);
+	}
 }
-inline float H1(const float x0, const float x1, const float x) {
-	return H0(x1, x0, x);
+
+SegmentPatch samplesPatch(SplineCache& s, int first, int last, FrameArena& arena) {
+	int* ids = arena.alloc<int>(last - first + 1);
+	int m = 0;
+	for (int i = first; i <= last; i++) {
+		if (s.count[i] == 0)
+			ids[m++] = i;
+	}
+	SampleSegments(s, ids, m);
+	SegmentPatch patch;
+	patch.first = first;
+	patch.last = last;
+	patch.size = 1;
+	for (int i = first; i <= last; i++)
+		patch.size += s.count[i];
+	patch.x = arena.alloc<float>(patch.size);
+	patch.y = arena.alloc<float>(patch.size);
+	int o = 0;
+	for (int i = first; i <= last; i++) {
+		std::copy(s.sx.begin() + s.offset[i], s.sx.begin() + s.offset[i] + s.count[i], patch.x + o);
+		std::copy(s.sy.begin() + s.offset[i], s.sy.begin() + s.offset[i] + s.count[i], patch.y + o);
+		o += s.count[i];
+	}
+	patch.x[o] = s.x[last + 1];
+	patch.y[o] = s.y[last + 1];
+	return patch;
 }
 
-void SlopeSpline(std::vector<Ubpa::pointf2>& ret, std::vector<Ubpa::pointf2>& p, std::vector<Slope>& k) {
-	// spdlog::info("SlopeSpline");
-	for (int i = 0; i < p.size() - 1; ++i) {
-		float y0 = p[i][1];
-		float y1 = p[i + 1][1];
-		float dy0 = k[i].r;
-		float dy1 = k[i + 1].l;
-		for (float x = p[i][0]; x <= p[i + 1][0]; x += t_step) {
-			ret.push_back(Ubpa::pointf2(x,
-				y0 * h0(p[i][0], p[i + 1][0], x) +
-				y1 * h1(p[i][0], p[i + 1][0], x) +
-				dy0 * H0(p[i][0], p[i + 1][0], x) +
-				dy1 * H1(p[i][0], p[i + 1][0], x)));
+void drawSamples(SplineCache& s, FrameArena& arena, ImDrawList* draw_list, const ImVec2& origin, float zoom, int edit_flag, const SegmentPatch* patch, int patches) {
+	// clip rect in canvas coordinates, grown by the line width
+	ImVec2 clip_min = draw_list->GetClipRectMin();
+	ImVec2 clip_max = draw_list->GetClipRectMax();
+	float x0 = (clip_min.x - origin.x - 2.f) / zoom, y0 = (clip_min.y - origin.y - 2.f) / zoom;
+	float x1 = (clip_max.x - origin.x + 2.f) / zoom, y1 = (clip_max.y - origin.y + 2.f) / zoom;
+	// the visible segments without samples are evaluated together, in parallel for many of them
+	auto patched = [&](int i) {
+		for (int j = 0; patch && j < patches; j++) {
+			if (i >= patch[j].first && i <= patch[j].last)
+				return true;
 		}
+		return false;
+	};
+	int* ids = arena.alloc<int>(s.segments());
+	int m = 0;
+	ForEachVisible(s, x0, y0, x1, y1, [&](int i) {
+		if (s.count[i] == 0 && !patched(i))
+			ids[m++] = i;
+	});
+	SampleSegments(s, ids, m);
+
+	// consecutive visible segments are joined into one polyline, the vertices of a segment
+	// start at its knot so a run only has to be closed by the knot after its last segment
+	ImVec2* run = arena.alloc<ImVec2>(max_polyline + 1);
+	int run_size = 0;
+	int run_end = -1;
+	auto flush = [&]() {
+		if (run_size == 0)
+			return;
+		run[run_size++] = ImVec2(origin.x + zoom * s.x[run_end], origin.y + zoom * s.y[run_end]);
+		AddPolyline(run, run_size, draw_list, edit_flag);
+		run_size = 0;
+	};
+	ForEachVisible(s, x0, y0, x1, y1, [&](int i) {
+		if (i != run_end)
+			flush();
+		if (patched(i)) {
+			run_end = -1;
+			return;
+		}
+		const float* px = s.sx.data() + s.offset[i];
+		const float* py = s.sy.data() + s.offset[i];
+		for (int j = 0; j < s.count[i]; j++) {
+			if (run_size == max_polyline) {
+				// split long runs, the next one starts where this one ends
+				AddPolyline(run, run_size, draw_list, edit_flag);
+				run[0] = run[run_size - 1];
+				run_size = 1;
+			}
+			run[run_size++] = ImVec2(origin.x + zoom * px[j], origin.y + zoom * py[j]);
+		}
+		run_end = i + 1;
+	});
+	flush();
+
+	for (int k = 0; patch && k < patches; k++) {
+		const SegmentPatch& p = patch[k];
+		if (p.size < 2)
+			continue;
+		ImVec2* pts = arena.alloc<ImVec2>(p.size);
+		for (int j = 0; j < p.size; j++)
+			pts[j] = ImVec2(origin.x + zoom * p.x[j], origin.y + zoom * p.y[j]);
+		AddPolyline(pts, p.size, draw_list, edit_flag);
 	}
 }
 
-void CubicSpline(std::vector<Ubpa::pointf2>& ret, std::vector<Ubpa::pointf2>& p, std::vector<Slope>& k, bool edit_flag) {
-	size_t n = p.size() - 1;
-	std::vector<float> u(n);
-	std::vector<float> h(n);
-	std::vector<float> v(n);
-	std::vector<float> b(n);
-	h[0] = p[1][0] - p[0][0];
-	b[0] = 6.f * (p[1][1] - p[0][1]) / h[0];
-	for (int i = 1; i < n; ++i) {
-		h[i] = p[i + 1][0] - p[i][0];
-		u[i] = 2.f * (h[i] + h[i - 1]);
-		b[i] = 6.f * (p[i + 1][1] - p[i][1]) / h[i];
-		v[i] = b[i] - b[i - 1];
-	}
-	std::vector<float> M(n + 1, 0.f);
-	for (int i = 2; i < n; ++i) {
-		b[i] = h[i - 1] / u[i - 1];
-		u[i] -= h[i - 1] * b[i];
-	}
-	// Ly = f
-	for (int i = 2; i < n; ++i) {
-		v[i] -= b[i] * v[i - 1];
-	}
-	// UM = Y
-	if (n > 1) {
-		M[n - 1] = v[n - 1] / u[n - 1];
-	}
-	for (int i = n - 2; i >= 1; --i) {
-		M[i] = (v[i] - h[i] * M[i + 1]) / u[i];
-	}
-	for (int i = 0; i < n; i++) {
-		/*float a1 = M[i] / (6.f * h[i]);
-		float a2 = M[i + 1] / (6 * h[i]);
-		float a3 = (p[i + 1][1] / h[i] - M[i + 1] * h[i] / 6.f);
-		float a4 = (p[i][1] / h[i] - M[i] * h[i] / 6.f);*/
-		float y0 = p[i][1];
-		float y1 = p[i + 1][1];
-		float dy0 = (-h[i]) * (M[i] * 2 + M[i + 1]) / 6.f + (p[i + 1][1] - p[i][1]) / h[i];
-		float dy1 = (h[i]) * (M[i + 1] * 2 + M[i]) / 6.f + (p[i + 1][1] - p[i][1]) / h[i];
-		if (!edit_flag) {
-			k[i].r = dy0;
-			// spdlog::info("{:.5f}", k[i].r);
-			if (i != 0) k[i].l = dy0;
-			if (i == n - 1) k[i + 1].l = dy1;
+void drawBSpline(const BSplineCache& s, FrameArena& arena, ImDrawList* draw_list, const ImVec2& origin, float zoom, int edit_flag) {
+	ImVec2 clip_min = draw_list->GetClipRectMin();
+	ImVec2 clip_max = draw_list->GetClipRectMax();
+	float x0 = (clip_min.x - origin.x - 2.f) / zoom, y0 = (clip_min.y - origin.y - 2.f) / zoom;
+	float x1 = (clip_max.x - origin.x + 2.f) / zoom, y1 = (clip_max.y - origin.y + 2.f) / zoom;
+	// consecutive visible spans are one run of samples, closed by the first sample of the next
+	ImVec2* run = arena.alloc<ImVec2>(max_polyline);
+	int m = s.per_span;
+	int run_first = -1, run_last = -1;
+	auto flush = [&]() {
+		if (run_first < 0)
+			return;
+		int end = (run_last + 1) * m;
+		for (int a = run_first * m; a < end; a += max_polyline - 1) {
+			int size = std::min(max_polyline, end - a + 1);
+			for (int j = 0; j < size; j++)
+				run[j] = ImVec2(origin.x + zoom * s.sx[a + j], origin.y + zoom * s.sy[a + j]);
+			AddPolyline(run, size, draw_list, edit_flag);
 		}
-		for (float x = p[i][0]; x <= p[i + 1][0]; x += t_step) {
-			//S = h0*y0 + h1*y1 + dy0*H0 + dy1*H1;
-			ret.push_back(Ubpa::pointf2(x,
-				y0 * h0(p[i][0], p[i + 1][0], x) +
-				y1 * h1(p[i][0], p[i + 1][0], x) +
-				dy0 * H0(p[i][0], p[i + 1][0], x) +
-				dy1 * H1(p[i][0], p[i + 1][0], x)));
+		run_first = -1;
+	};
+	ForEachVisible(s, x0, y0, x1, y1, [&](int i) {
+		if (run_first < 0 || i != run_last + 1) {
+			flush();
+			run_first = i;
 		}
+		run_last = i;
+	});
+	flush();
+}
+
+void drawControlPolygon(const PointStore& points, ImDrawList* draw_list, const ImVec2& origin, float zoom) {
+	for (int i = 0; i + 1 < (int)points.size(); i++)
+		draw_list->AddLine(ImVec2(origin.x + zoom * points.x[i], origin.y + zoom * points.y[i]),
+			ImVec2(origin.x + zoom * points.x[i + 1], origin.y + zoom * points.y[i + 1]), slope_col, 1.f);
+}
+
+void drawBezierCurve(const float* x, const float* y, int n, FrameArena& arena, ImDrawList* draw_list, const ImVec2& origin, float zoom, int edit_flag) {
+	float* sx = arena.alloc<float>(sample_num);
+	float* sy = arena.alloc<float>(sample_num);
+	if (!SampleBezier(x, y, n, sample_num, sx, sy))
+		return;
+	ImVec2* pts = arena.alloc<ImVec2>(sample_num);
+	for (int j = 0; j < sample_num; j++)
+		pts[j] = ImVec2(origin.x + zoom * sx[j], origin.y + zoom * sy[j]);
+	AddPolyline(pts, sample_num, draw_list, edit_flag);
+}
+
+void drawBezierCurveDrag(CanvasData* data, const Ubpa::pointf2& p, ImDrawList* draw_list, const ImVec2& origin) {
+	// every point moves the whole curve, it is sampled again with the dragged point in a copy
+	int n = (int)data->points.size();
+	float* x = data->frame_arena.alloc<float>(n);
+	float* y = data->frame_arena.alloc<float>(n);
+	std::copy(data->points.x.begin(), data->points.x.end(), x);
+	std::copy(data->points.y.begin(), data->points.y.end(), y);
+	x[data->editing_index] = p[0];
+	y[data->editing_index] = p[1];
+	drawBezierCurve(x, y, n, data->frame_arena, draw_list, origin, data->zoom, 1);
+}
+
+void drawBSplineDrag(CanvasData* data, const Ubpa::pointf2& p, ImDrawList* draw_list, const ImVec2& origin) {
+	updateCurveCache(data, false);
+	CurveCache& cache = data->curve_cache;
+	// over the curve before the drag
+	const PolylineLod* lod = curveLod(data);
+	int k = data->editing_index;
+	// the cached curve itself is moved, the next update moves the point back unless the drag
+	// was committed
+	int first, last;
+	MoveControlPoint(cache.bspline, k, p[0], p[1], data->points.w[k], first, last);
+	cache.bspline_dragged = true;
+	const BSplineCache& b = cache.bspline;
+	if (lod) {
+		// the samples of the spans that moved, the last one closes them
+		int a = first * b.per_span, e = (last + 1) * b.per_span;
+		PolylineEdit edit = { a, e, b.sx.data() + a, b.sy.data() + a, e - a + 1 };
+		drawLod(*lod, &edit, 1, data->frame_arena, draw_list, origin, data->zoom, 1);
 	}
+	else
+		drawBSpline(b, data->frame_arena, draw_list, origin, data->zoom, 1);
 }
 
-// xt, yt == data->points at first
-void UniformParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt) {
-	//spdlog::info("UniformParameterize");
-	// t is in the range 0 to 1, and uniformed mapping to x and y
-	float step = 1.f / (xt.size() - 1), t = 0.0;
-	for (int i = 0; i < xt.size(); t += step, i++) {
-		// (t_i, x_i)
-		xt[i][1] = xt[i][0];
-		xt[i][0] = t;
-		// (t_i, y_i)
-		yt[i][0] = t;
-		//spdlog::info("{:.2f}", t);
+void drawSplineDrag(CanvasData* data, const Ubpa::pointf2& p, ImDrawList* draw_list, const ImVec2& origin) {
+	SplineDrag& drag = data->spline_drag;
+	if (!drag.valid || drag.index != data->editing_index)
+		drag.begin(data->points.x.data(), data->points.y.data(), (int)data->points.size(), data->param_type, sample_num, data->editing_index, data->closed);
+	drag.move(data->param_type, p[0], p[1], drag_tol, data->frame_arena);
+	if (!curveLod(data)) {
+		drawSamples(drag.work, data->frame_arena, draw_list, origin, data->zoom, 1);
+		return;
 	}
+	// a long curve is drawn from its level of detail, the segments between the knots that moved
+	// from their own samples
+	if (drag.hi > drag.lo) {
+		SegmentPatch patch = samplesPatch(drag.work, drag.lo, drag.hi - 1, data->frame_arena);
+		drawCurve(data, draw_list, origin, 1, &patch);
+	}
+	else
+		drawCurve(data, draw_list, origin, 1);
 }
 
-void ChordalParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt) {
-	//spdlog::info("ChordalParameterize");
-	std::vector<float> k(xt.size() - 1);
-	float sum = 0.f, t = 0.f;
-	for (int i = 0; i < xt.size() - 1; i++) {
-		k[i] = xt[i + 1].distance(xt[i]);
-		sum += k[i];
-	}
-	for (int i = 0; i < xt.size(); i++) {
-		// (t_i, x_i)
-		xt[i][1] = xt[i][0];
-		xt[i][0] = t / sum;
-		// (t_i, y_i)
-		yt[i][0] = t / sum;
-		//spdlog::info("{:.2f}", t/sum);
-		if (i < k.size()) t += k[i];
+void drawLocalSplineDrag(CanvasData* data, const Ubpa::pointf2& p, ImDrawList* draw_list, const ImVec2& origin) {
+	updateCurveCache(data, false);
+	SplineCache& s = data->curve_cache.local;
+	FrameArena& arena = data->frame_arena;
+	int k = data->editing_index;
+	// the knot moves for the control points of the segments it changes and back again, the same
+	// intervals and slopes come back and the cached samples stay valid
+	float x = s.x[k], y = s.y[k];
+	int ids[max_local_segments];
+	int m = UpdateLocalKnot(s, data->param_type, data->shape, k, p[0], p[1], ids);
+	float* cx = arena.alloc<float>(4 * m);
+	float* cy = arena.alloc<float>(4 * m);
+	for (int j = 0; j < m; j++)
+		ControlPoints(s, ids[j], cx + 4 * j, cy + 4 * j);
+	UpdateLocalKnot(s, data->param_type, data->shape, k, x, y, ids);
+	// a closed curve has a second run of segments across the seam
+	SegmentPatch patches[2];
+	int count = 0;
+	for (int j = 0; j < m;) {
+		int e = j;
+		while (e + 1 < m && ids[e + 1] == ids[e] + 1)
+			e++;
+		patches[count++] = SamplePatch(s, ids[j], ids[e], cx + 4 * j, cy + 4 * j, arena);
+		j = e + 1;
+	}
+	drawCurve(data, draw_list, origin, 1, patches, count);
+}
+
+// handles of point i of the Bezier curve through p(0)..p(n - 1), l is unused for the first
+// point and r for the last
+template<typename P>
+void bezierHandles(P&& p, int n, int i, Ubpa::pointf2& l, Ubpa::pointf2& r) {
+	Ubpa::pointf2 c = p(i);
+	l = r = c;
+	if (n == 2) {
+		float dx = (p(1)[0] - p(0)[0]) / 3.f, dy = (p(1)[1] - p(0)[1]) / 3.f;
+		if (i == 0)
+			r = Ubpa::pointf2(c[0] + dx, c[1] + dy);
+		else
+			l = Ubpa::pointf2(c[0] - dx, c[1] - dy);
+		return;
+	}
+	if (i == 0)
+		r = Ubpa::pointf2(c[0] + (p(1)[0] - p(2)[0]) / 6.f, c[1] + (p(1)[1] - p(2)[1]) / 6.f);
+	else if (i == n - 1)
+		l = Ubpa::pointf2(c[0] - (p(n - 2)[0] - p(n - 3)[0]) / 6.f, c[1] - (p(n - 2)[1] - p(n - 3)[1]) / 6.f);
+	else {
+		float dx = p(i + 1)[0] - p(i - 1)[0];
+		float dy = p(i + 1)[1] - p(i - 1)[1];
+		r = Ubpa::pointf2(c[0] + dx / 6.f, c[1] + dy / 6.f);
+		l = Ubpa::pointf2(c[0] - dx / 6.f, c[1] - dy / 6.f);
+	}
+}
+
+void fitBezier(SplineCache& s, PointStore& points) {
+	int n = (int)points.size();
+	s.closed = false;
+	s.assign(points.x.data(), points.y.data(), n);
+	// a Bezier segment is the Hermite segment on [0, 1] with slopes 3 (handle - point)
+	std::fill(s.h.begin(), s.h.end(), 1.f);
+	if (n == 2) {
+		for (int i = 0; i < 2; i++) {
+			s.kx[i].l = s.kx[i].r = points.x[1] - points.x[0];
+			s.ky[i].l = s.ky[i].r = points.y[1] - points.y[0];
+		}
+		SampleAdaptive(s, flatness_tol);
+		return;
+	}
+	auto p = [&](int j) { return Ubpa::pointf2(points.x[j], points.y[j]); };
+	for (int i = 0; i < n; ++i) {
+		Ubpa::pointf2 l, r;
+		bezierHandles(p, n, i, l, r);
+		if (i > 0) {
+			points.lx[i] = l[0];
+			points.ly[i] = l[1];
+		}
+		if (i < n - 1) {
+			points.rx[i] = r[0];
+			points.ry[i] = r[1];
+		}
+	}
+	for (int i = 0; i < n; ++i) {
+		s.kx[i].r = 3.f * (points.rx[i] - points.x[i]);
+		s.ky[i].r = 3.f * (points.ry[i] - points.y[i]);
+		s.kx[i].l = 3.f * (points.x[i] - points.lx[i]);
+		s.ky[i].l = 3.f * (points.y[i] - points.ly[i]);
 	}
+	SampleAdaptive(s, flatness_tol);
 }
 
-void CentripetalParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt) {
-	//spdlog::info("CentripetalParameterize");
-	std::vector<float> k(xt.size() - 1);
-	float sum = 0.f, t = 0.f;
-	for (int i = 0; i < xt.size() - 1; i++) {
-		k[i] = std::sqrt(xt[i + 1].distance(xt[i]));
-		sum += k[i];
-	}
-	for (int i = 0; i < xt.size(); i++) {
-		// (t_i, x_i)
-		xt[i][1] = xt[i][0];
-		xt[i][0] = t / sum;
-		// (t_i, y_i)
-		yt[i][0] = t / sum;
-		//spdlog::info("{:.2f}", t / sum);
-		if (i < k.size()) t += k[i];
+void drawBezierDrag(CanvasData* data, const Ubpa::pointf2& p, ImDrawList* draw_list, const ImVec2& origin) {
+	updateCurveCache(data, false);
+	SplineCache& base = data->curve_cache.curve;
+	FrameArena& arena = data->frame_arena;
+	int n = (int)data->points.size();
+	int k = data->editing_index;
+	// the handles of a point depend on its neighbours, and the end handles on the two points
+	// after or before them
+	int first = std::max(0, k - 2);
+	int last = std::min(n - 2, k + 1);
+	int m = last - first + 1;
+	float* cx = arena.alloc<float>(4 * m);
+	float* cy = arena.alloc<float>(4 * m);
+	auto moved = [&](int j) { return j == k ? p : data->point(j); };
+	for (int i = first; i <= last; i++) {
+		Ubpa::pointf2 l0, r0, l1, r1;
+		bezierHandles(moved, n, i, l0, r0);
+		bezierHandles(moved, n, i + 1, l1, r1);
+		float* px = cx + 4 * (i - first);
+		float* py = cy + 4 * (i - first);
+		px[0] = moved(i)[0];
+		py[0] = moved(i)[1];
+		px[1] = r0[0];
+		py[1] = r0[1];
+		px[2] = l1[0];
+		py[2] = l1[1];
+		px[3] = moved(i + 1)[0];
+		py[3] = moved(i + 1)[1];
 	}
+	SegmentPatch patch = SamplePatch(base, first, last, cx, cy, arena);
+	drawCurve(data, draw_list, origin, 1, &patch);
 }
 
-// get angle
-inline float getAngle(Ubpa::pointf2& A, Ubpa::pointf2& B, Ubpa::pointf2& C) {
-	Ubpa::vecf2 BA = A - B;
-	Ubpa::vecf2 BC = C - B;
-	return acos(BA.dot(BC) / (BA.norm() * BC.norm()));
+void fitSpline(SplineCache& s, CanvasData* data, bool with_slope) {
+	PointStore& points = data->points;
+	int n = (int)points.size();
+	// Parameterize
+	s.closed = data->closed;
+	s.assign(points.x.data(), points.y.data(), n);
+	Parameterize(s, data->param_type);
+	Knots(s.h.data(), n, points.t.data());
+	if (with_slope) {
+		SlopeSpline(s, points.kx.data(), points.ky.data());
+	}
+	else {
+		CubicSpline(s, data->frame_arena);
+		// a closed curve repeats the slopes of the first point at its last knot
+		std::copy(s.kx.begin(), s.kx.begin() + n, points.kx.begin());
+		std::copy(s.ky.begin(), s.ky.begin() + n, points.ky.begin());
+		for (int i = 0; i < n - 1; i++) {
+			points.rratio[i] = base_tangent_len / std::sqrt(points.kx[i].r * points.kx[i].r + points.ky[i].r * points.ky[i].r);
+			points.rx[i] = points.x[i] + points.kx[i].r * points.rratio[i];
+			points.ry[i] = points.y[i] + points.ky[i].r * points.rratio[i];
+		}
+		for (int i = n - 1; i > 0; i--) {
+			points.lratio[i] = base_tangent_len / std::sqrt(points.kx[i].l * points.kx[i].l + points.ky[i].l * points.ky[i].l);
+			points.lx[i] = points.x[i] - points.kx[i].l * points.lratio[i];
+			points.ly[i] = points.y[i] - points.ky[i].l * points.lratio[i];
+		}
+	}
+	SampleSpline(s, sample_num);
 }
 
-inline float getDeltaT(float d0, float d1, float d2, float a0, float a1, int flag = 1) {
-	//return d0 * (1.f + 1.5f * d1 * (std::min(Ubpa::PI<float> / 2.f, Ubpa::PI<float> -a)) / (d0 + d1));
-	return d1 * (1.f +
-		1.5f * d0 * (std::min(Ubpa::PI<float> / 2.f, Ubpa::PI<float> -a0) / (d0 + d1)) +
-		1.5f * d2 * (std::min(Ubpa::PI<float> / 2.f, Ubpa::PI<float> -a1) / (d1 + d2)) * flag);
+void drawTangentPreview(CanvasData* data, int k, const Ubpa::pointf2& lt, const Ubpa::pointf2& rt,
+	ImDrawList* draw_list, const ImVec2& origin) {
+	updateCurveCache(data, true);
+	SplineCache& base = data->curve_cache.curve;
+	FrameArena& arena = data->frame_arena;
+	int n = (int)data->points.size();
+	Ubpa::pointf2 p = data->point(k);
+	float lratio = data->points.lratio[k], rratio = data->points.rratio[k];
+	// only the slopes of knot k change, so only the two segments next to it
+	int first = std::max(0, k - 1);
+	int last = std::min(n - 2, k);
+	int m = last - first + 1;
+	float* cx = arena.alloc<float>(4 * m);
+	float* cy = arena.alloc<float>(4 * m);
+	for (int i = first; i <= last; i++) {
+		int j = i - first;
+		ControlPoints(base, i, cx + 4 * j, cy + 4 * j);
+		if (i == k - 1) {
+			cx[4 * j + 2] = p[0] - base.h[i] / 3.f * (p[0] - lt[0]) / lratio;
+			cy[4 * j + 2] = p[1] - base.h[i] / 3.f * (p[1] - lt[1]) / lratio;
+		}
+		else {
+			cx[4 * j + 1] = p[0] + base.h[i] / 3.f * (rt[0] - p[0]) / rratio;
+			cy[4 * j + 1] = p[1] + base.h[i] / 3.f * (rt[1] - p[1]) / rratio;
+		}
+	}
+	SegmentPatch patch = SamplePatch(base, first, last, cx, cy, arena);
+	drawTangents(data, draw_list, origin, 2, k, lt, rt);
+	drawCurve(data, draw_list, origin, 2, &patch);
 }
 
-void FoleyParameterize(std::vector<Ubpa::pointf2>& xt, std::vector<Ubpa::pointf2>& yt) {
-	//spdlog::info("FoleyParameterize");
-	// at least 3 points
-	if (xt.size() < 3) {
-		UniformParameterize(xt, yt);
+void drawTangents(CanvasData* data, ImDrawList* draw_list, const ImVec2& origin, int edit_flag,
+	int k, const Ubpa::pointf2& lt, const Ubpa::pointf2& rt) {
+	if (data->edit_point != 2 && data->edit_point != 3)
 		return;
+	const PointStore& points = data->points;
+	float zoom = data->zoom;
+	for (int i = 0; i < data->points.size() - 1; i++) {
+		Ubpa::pointf2 t = i == k ? rt : data->rtangent(i);
+		const ImVec2 p1(origin.x + zoom * points.x[i], origin.y + zoom * points.y[i]);
+		const ImVec2 p2(origin.x + zoom * t[0], origin.y + zoom * t[1]);
+		if (!edit_flag) {
+			draw_list->AddLine(p1, p2, slope_col, 2.f);
+			draw_list->AddCircleFilled(p2, point_radius, normal_point_col);
+		}
+		else {
+			if (edit_flag == 2) draw_list->AddLine(p1, p2, select_slope_col, 2.f);
+			draw_list->AddCircleFilled(p2, point_radius, select_point_col);
+		}
+	}
+	for (int i = data->points.size() - 1; i > 0; i--) {
+		Ubpa::pointf2 t = i == k ? lt : data->ltangent(i);
+		const ImVec2 p1(origin.x + zoom * points.x[i], origin.y + zoom * points.y[i]);
+		const ImVec2 p2(origin.x + zoom * t[0], origin.y + zoom * t[1]);
+		if (!edit_flag) {
+			draw_list->AddLine(p1, p2, slope_col, 2.f);
+			draw_list->AddCircleFilled(p2, point_radius, normal_point_col);
+		}
+		else {
+			if (edit_flag == 2) draw_list->AddLine(p1, p2, select_slope_col, 2.f);
+			draw_list->AddCircleFilled(p2, point_radius, select_point_col);
+		}
 	}
-	std::vector<float> d(xt.size() - 1);
-	std::vector<float> a(xt.size() - 2);
-	std::vector<float> dt(xt.size() - 1);
-	for (int i = 0; i < xt.size() - 1; i++) {
-		d[i] = xt[i + 1].distance(xt[i]);
-	}
-	for (int i = 1; i < xt.size() - 1; i++) {
-		a[i - 1] = getAngle(xt[i - 1], xt[i], xt[i + 1]);
-	}
-	dt[0] = getDeltaT(d[1], d[0], 0.f, a[0], 0.f, 0);
-	int n = dt.size() - 1;
-	if (n > 0)
-		dt[n] = getDeltaT(d[n - 1], d[n], 0.f, a[n - 1], 0.f, 0);
-	for (int i = 1; i < n; i++)
-		dt[i] = getDeltaT(d[i - 1], d[i], d[i + 1], a[i - 1], a[i]);
-	float sum = 0.f, t = 0.f;
-	for (int i = 0; i <= n; i++) sum += dt[i];
-	for (int i = 0; i < xt.size(); i++) {
-		// (t_i, x_i)
-		xt[i][1] = xt[i][0];
-		xt[i][0] = t / sum;
-		// (t_i, y_i)
-		yt[i][0] = t / sum;
-		//spdlog::info("{:.2f}", t / sum);
-		if (i < dt.size()) t += dt[i];
-	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,92 @@
+#include "ArcLength.h"
+
+#include <algorithm>
+#include <cmath>
+
+// nodes and weights on [-1, 1]
+constexpr float gl_node[5] = { -0.9061798459f, -0.5384693101f, 0.f, 0.5384693101f, 0.9061798459f };
+constexpr float gl_weight[5] = { 0.2369268851f, 0.4786286705f, 0.5688888889f, 0.4786286705f, 0.2369268851f };
+
+inline float speed(const CubicCoeffs& c, float t) {
+	float dx = (3.f * c.dx * t + 2.f * c.cx) * t + c.bx;
+	float dy = (3.f * c.dy * t + 2.f * c.cy) * t + c.by;
+	return std::sqrt(dx * dx + dy * dy);
+}
+
+float CubicLength(const CubicCoeffs& c, float t0, float t1) {
+	float half = 0.5f * (t1 - t0), mid = 0.5f * (t0 + t1);
+	float sum = 0.f;
+	for (int k = 0; k < 5; k++)
+		sum += gl_weight[k] * speed(c, mid + half * gl_node[k]);
+	return sum * half;
+}
+
+void BuildArcLength(ArcLengthTable& a, const SplineCache& s, int pieces) {
+	int n = s.segments();
+	a.pieces = pieces;
+	a.coeffs.resize(n);
+	a.acc.resize(n * pieces + 1);
+	a.acc[0] = 0.f;
+	float dt = 1.f / pieces;
+	for (int i = 0; i < n; i++) {
+		a.coeffs[i] = SegmentCoeffs(s, i);
+		for (int j = 0; j < pieces; j++) {
+			int k = i * pieces + j;
+			a.acc[k + 1] = a.acc[k] + CubicLength(a.coeffs[i], j * dt, (j + 1) * dt);
+		}
+	}
+}
+
+// parameter in piece k at length r from its start, Newton on the length bracketed by the piece
+static float invertPiece(const ArcLengthTable& a, int k, float r) {
+	int i = k / a.pieces;
+	const CubicCoeffs& c = a.coeffs[i];
+	float t0 = (float)(k - i * a.pieces) / a.pieces;
+	float t1 = t0 + 1.f / a.pieces;
+	float len = a.acc[k + 1] - a.acc[k];
+	if (len <= 0.f)
+		return t0;
+	float lo = t0, hi = t1;
+	float t = t0 + (t1 - t0) * (r / len);
+	for (int it = 0; it < 8; it++) {
+		float f = CubicLength(c, t0, t) - r;
+		if (std::abs(f) < 1e-5f * len)
+			break;
+		if (f > 0.f)
+			hi = t;
+		else
+			lo = t;
+		float v = speed(c, t);
+		float next = v > 0.f ? t - f / v : lo;
+		// bisect whenever Newton leaves the bracket
+		t = next > lo && next < hi ? next : 0.5f * (lo + hi);
+	}
+	return t;
+}
+
+void ArcLengthParam(const ArcLengthTable& a, float d, int& i, float& t) {
+	int m = (int)a.acc.size() - 1;
+	d = std::clamp(d, 0.f, a.length());
+	int k = (int)(std::upper_bound(a.acc.begin(), a.acc.end(), d) - a.acc.begin()) - 1;
+	k = std::clamp(k, 0, m - 1);
+	i = k / a.pieces;
+	t = invertPiece(a, k, d - a.acc[k]);
+}
+
+void SampleArcLength(const ArcLengthTable& a, int n, float* x, float* y) {
+	int m = (int)a.acc.size() - 1;
+	if (m <= 0)
+		return;
+	float step = a.length() / (n - 1);
+	// the lengths are increasing, so the piece only moves forward
+	int k = 0;
+	for (int j = 0; j < n; j++) {
+		float d = j == n - 1 ? a.length() : j * step;
+		while (k < m - 1 && a.acc[k + 1] <= d)
+			k++;
+		float t = invertPiece(a, k, d - a.acc[k]);
+		const CubicCoeffs& c = a.coeffs[k / a.pieces];
+		x[j] = ((c.dx * t + c.cx) * t + c.bx) * t + c.ax;
+		y[j] = ((c.dy * t + c.cy) * t + c.by) * t + c.ay;
+	}
+}
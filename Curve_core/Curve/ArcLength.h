@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CubicEval.h"
+#include "Spline.h"
+
+#include <vector>
+
+// length of c on [t0, t1], 5 point Gauss-Legendre quadrature of the speed
+float CubicLength(const CubicCoeffs& c, float t0, float t1);
+
+// cumulative arc length of a curve. Every segment is split into pieces of equal parameter
+// length that are integrated separately, so a point at a given length is one binary search
+// and a few Newton steps inside a single piece away.
+struct ArcLengthTable {
+	int pieces{ 8 };
+	std::vector<CubicCoeffs> coeffs;
+	// length from the start of the curve to the start of piece j of segment i at i * pieces + j,
+	// the last entry is the total length
+	std::vector<float> acc;
+
+	int segments() const { return (int)coeffs.size(); }
+	float length() const { return acc.empty() ? 0.f : acc.back(); }
+};
+
+void BuildArcLength(ArcLengthTable& a, const SplineCache& s, int pieces = 8);
+
+// segment i and its parameter t in [0, 1] at arc length d from the start of the curve
+void ArcLengthParam(const ArcLengthTable& a, float d, int& i, float& t);
+
+// n >= 2 points at uniform arc length spacing from the first knot to the last into SoA x, y
+void SampleArcLength(const ArcLengthTable& a, int n, float* x, float* y);
@@ -0,0 +1,241 @@
+#include "BSpline.h"
+
+#include "Parameterization.h"
+
+#include <algorithm>
+
+int FindSpan(const float* u, int n, int d, float t) {
+	if (t >= u[n]) {
+		// the last span that is not empty
+		int span = n - 1;
+		while (span > d && u[span] >= u[n])
+			span--;
+		return span;
+	}
+	t = std::max(t, u[d]);
+	// u[lo] <= t < u[hi]
+	int lo = d, hi = n;
+	while (hi - lo > 1) {
+		int mid = (lo + hi) / 2;
+		if (t < u[mid])
+			hi = mid;
+		else
+			lo = mid;
+	}
+	return lo;
+}
+
+template<int D>
+int InsertKnot(std::vector<float>& u, std::vector<float>& x, std::vector<float>& y, std::vector<float>& w, float t) {
+	int n = (int)x.size();
+	int k = FindSpan(u.data(), n, D, t);
+	// points k - D + 1..k are blended from their neighbours in homogeneous coordinates, the
+	// ones after shift up by one
+	float qx[D], qy[D], qw[D];
+	for (int i = k - D + 1; i <= k; i++) {
+		float a = (t - u[i]) / (u[i + D] - u[i]);
+		int j = i - (k - D + 1);
+		qw[j] = (1.f - a) * w[i - 1] + a * w[i];
+		qx[j] = ((1.f - a) * w[i - 1] * x[i - 1] + a * w[i] * x[i]) / qw[j];
+		qy[j] = ((1.f - a) * w[i - 1] * y[i - 1] + a * w[i] * y[i]) / qw[j];
+	}
+	x.insert(x.begin() + k, 0.f);
+	y.insert(y.begin() + k, 0.f);
+	w.insert(w.begin() + k, 0.f);
+	for (int j = 0; j < D; j++) {
+		int i = k - D + 1 + j;
+		x[i] = qx[j];
+		y[i] = qy[j];
+		w[i] = qw[j];
+	}
+	u.insert(u.begin() + k + 1, t);
+	return k;
+}
+
+template int InsertKnot<1>(std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<float>&, float);
+template int InsertKnot<2>(std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<float>&, float);
+template int InsertKnot<3>(std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<float>&, float);
+template int InsertKnot<4>(std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<float>&, float);
+template int InsertKnot<5>(std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<float>&, float);
+
+void BSplineCache::assign(const float* px, const float* py, const float* pw, int n, int d) {
+	degree = d;
+	x.assign(px, px + n);
+	y.assign(py, py + n);
+	if (pw)
+		w.assign(pw, pw + n);
+	else
+		w.assign(n, 1.f);
+}
+
+void BSplineKnots(BSplineCache& s, int param_type) {
+	int n = s.points(), d = s.degree;
+	s.u.resize(n + d + 1);
+	if (n <= d)
+		return;
+	std::vector<float> t;
+	if (param_type != 0 && n > 2) {
+		std::vector<float> h(n - 1);
+		t.resize(n);
+		ParamFunc[param_type](s.x.data(), s.y.data(), n, h.data(), 0, n - 2);
+		Knots(h.data(), n, t.data());
+	}
+	if (t.empty() || !(t[n - 1] > 0.f)) {
+		for (int i = 0; i <= d; i++) {
+			s.u[i] = 0.f;
+			s.u[n + i] = (float)(n - d);
+		}
+		for (int j = 1; j < n - d; j++)
+			s.u[d + j] = (float)j;
+		return;
+	}
+	// the average of the parameters of d points in a row, as a running sum
+	for (int i = 0; i <= d; i++) {
+		s.u[i] = 0.f;
+		s.u[n + i] = t[n - 1];
+	}
+	double sum = 0.;
+	for (int i = 1; i < d; i++)
+		sum += t[i];
+	for (int j = 1; j < n - d; j++) {
+		sum += t[j + d - 1];
+		s.u[d + j] = (float)(sum / d);
+		sum -= t[j];
+	}
+}
+
+// bounds of the control points of span i
+static void spanBox(BSplineCache& s, int i) {
+	float* b = &s.box[4 * i];
+	b[0] = b[2] = s.x[i];
+	b[1] = b[3] = s.y[i];
+	for (int j = i + 1; j <= i + s.degree; j++) {
+		b[0] = std::min(b[0], s.x[j]);
+		b[1] = std::min(b[1], s.y[j]);
+		b[2] = std::max(b[2], s.x[j]);
+		b[3] = std::max(b[3], s.y[j]);
+	}
+}
+
+template<int D>
+static void sampleSpans(BSplineCache& s, int first, int last) {
+	const float* u = s.u.data();
+	int n = s.points(), m = s.per_span;
+	std::vector<float> t(m);
+	for (int i = first; i <= last; i++) {
+		spanBox(s, i);
+		int span = i + D;
+		// the weights drop out of a span whose points all have weight 1
+		const float* w = nullptr;
+		for (int j = i; j <= span; j++) {
+			if (s.w[j] != 1.f)
+				w = s.w.data();
+		}
+		float* px = s.sx.data() + i * m;
+		float* py = s.sy.data() + i * m;
+		float a = u[span], b = u[span + 1];
+		if (a == b) {
+			// an empty span is the point where the spans around it meet
+			float qx, qy;
+			int k = FindSpan(u, n, D, a);
+			DeBoor<D>(u, s.x.data(), s.y.data(), s.w.data(), k, a, qx, qy);
+			std::fill(px, px + m, qx);
+			std::fill(py, py + m, qy);
+			continue;
+		}
+		float step = (b - a) / m;
+		for (int j = 0; j < m; j++)
+			t[j] = a + step * j;
+		DeBoorSpan<D>(u, s.x.data(), s.y.data(), w, span, t.data(), m, px, py);
+	}
+	// a clamped curve ends in its last control point
+	if (last == s.spans() - 1) {
+		s.sx[s.spans() * m] = s.x[n - 1];
+		s.sy[s.spans() * m] = s.y[n - 1];
+	}
+}
+
+void SampleSpans(BSplineCache& s, int first, int last) {
+	switch (s.degree) {
+	case 1: sampleSpans<1>(s, first, last); break;
+	case 2: sampleSpans<2>(s, first, last); break;
+	case 3: sampleSpans<3>(s, first, last); break;
+	case 4: sampleSpans<4>(s, first, last); break;
+	case 5: sampleSpans<5>(s, first, last); break;
+	}
+}
+
+void SampleBSpline(BSplineCache& s, int per_span) {
+	s.per_span = per_span;
+	int spans = s.spans();
+	if (spans == 0) {
+		s.sx.clear();
+		s.sy.clear();
+		s.box.clear();
+		return;
+	}
+	s.sx.resize(spans * per_span + 1);
+	s.sy.resize(spans * per_span + 1);
+	s.box.resize(4 * spans);
+	SampleSpans(s, 0, spans - 1);
+}
+
+void SupportSpans(const BSplineCache& s, int k, int& first, int& last) {
+	first = std::max(k - s.degree, 0);
+	last = std::min(k, s.spans() - 1);
+}
+
+void MoveControlPoint(BSplineCache& s, int k, float x, float y, float w, int& first, int& last) {
+	s.x[k] = x;
+	s.y[k] = y;
+	s.w[k] = w;
+	SupportSpans(s, k, first, last);
+	SampleSpans(s, first, last);
+}
+
+int InsertKnot(BSplineCache& s, float t) {
+	int n = s.points(), d = s.degree;
+	if (n <= d || !(t > s.u[d] && t < s.u[n]))
+		return -1;
+	// a knot of multiplicity d already splits the curve, one more would break it
+	if (std::count(s.u.begin(), s.u.end(), t) >= d)
+		return -1;
+	int k = -1;
+	switch (d) {
+	case 1: k = InsertKnot<1>(s.u, s.x, s.y, s.w, t); break;
+	case 2: k = InsertKnot<2>(s.u, s.x, s.y, s.w, t); break;
+	case 3: k = InsertKnot<3>(s.u, s.x, s.y, s.w, t); break;
+	case 4: k = InsertKnot<4>(s.u, s.x, s.y, s.w, t); break;
+	case 5: k = InsertKnot<5>(s.u, s.x, s.y, s.w, t); break;
+	}
+	// span k - d is split in two, the spans after it keep their samples one span further on
+	int m = s.per_span;
+	int split = k - d;
+	s.sx.insert(s.sx.begin() + split * m, m, 0.f);
+	s.sy.insert(s.sy.begin() + split * m, m, 0.f);
+	s.box.insert(s.box.begin() + 4 * split, 4, 0.f);
+	// the moved points k - d + 1..k change the bounds of every span they are in
+	for (int i = std::max(k - 2 * d + 1, 0); i <= std::min(k, s.spans() - 1); i++)
+		spanBox(s, i);
+	SampleSpans(s, split, split + 1);
+	return k;
+}
+
+float ClosestSample(const BSplineCache& s, float x, float y) {
+	int best = 0;
+	float best_d = -1.f;
+	for (int q = 0; q < (int)s.sx.size(); q++) {
+		float dx = s.sx[q] - x, dy = s.sy[q] - y;
+		float d = dx * dx + dy * dy;
+		if (best_d < 0.f || d < best_d)
+			best = q, best_d = d;
+	}
+	return SampleParameter(s, best, 0.f);
+}
+
+float SampleParameter(const BSplineCache& s, int q, float f) {
+	int m = s.per_span, d = s.degree;
+	int i = std::min(q / m, s.spans() - 1);
+	float a = s.u[d + i], b = s.u[d + i + 1];
+	return a + (b - a) * (q - i * m + f) / m;
+}
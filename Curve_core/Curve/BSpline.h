@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vector>
+
+// degrees the B-spline functions are instantiated for
+constexpr int bspline_min_degree = 1;
+constexpr int bspline_max_degree = 5;
+
+// span of the clamped knots u of n control points and degree d that t falls in, the one with
+// u[span] <= t < u[span + 1] and d <= span < n, the end of the curve belongs to the last span
+int FindSpan(const float* u, int n, int d, float t);
+
+// de Boor's algorithm, the point at t in span of the B-spline of degree D over x, y, a NURBS
+// curve with the weights w unless they are null. The D + 1 control points of the span are
+// blended in homogeneous coordinates, every loop has a trip count known at compile time.
+template<int D, typename T>
+void DeBoor(const T* u, const T* x, const T* y, const T* w, int span, T t, T& px, T& py) {
+	static_assert(D >= 1, "a B-spline has at least degree 1");
+	T dx[D + 1], dy[D + 1], dw[D + 1];
+	for (int j = 0; j <= D; j++) {
+		int i = span - D + j;
+		dw[j] = w ? w[i] : T(1);
+		dx[j] = x[i] * dw[j];
+		dy[j] = y[i] * dw[j];
+	}
+	for (int r = 1; r <= D; r++) {
+		for (int j = D; j >= r; j--) {
+			int i = span - D + j;
+			T a = (t - u[i]) / (u[i + D - r + 1] - u[i]);
+			dx[j] = (T(1) - a) * dx[j - 1] + a * dx[j];
+			dy[j] = (T(1) - a) * dy[j - 1] + a * dy[j];
+			dw[j] = (T(1) - a) * dw[j - 1] + a * dw[j];
+		}
+	}
+	px = dx[D] / dw[D];
+	py = dy[D] / dw[D];
+}
+
+// DeBoor at the m parameters t of one span. The knot differences are inverted once, and the
+// parameters go through the recurrence chunk at a time, one lane each, so that the innermost
+// loops vectorize.
+template<int D, typename T>
+void DeBoorSpan(const T* u, const T* x, const T* y, const T* w, int span, const T* t, int m, T* px, T* py) {
+	constexpr int chunk = 8;
+	T inv[D + 1][D + 1];
+	for (int r = 1; r <= D; r++) {
+		for (int j = r; j <= D; j++) {
+			int i = span - D + j;
+			inv[r][j] = T(1) / (u[i + D - r + 1] - u[i]);
+		}
+	}
+	const T* ui = u + span - D;
+	for (int k0 = 0; k0 < m; k0 += chunk) {
+		int c = m - k0 < chunk ? m - k0 : chunk;
+		T tk[chunk], dx[D + 1][chunk], dy[D + 1][chunk], dw[D + 1][chunk];
+		for (int k = 0; k < chunk; k++)
+			tk[k] = t[k0 + (k < c ? k : 0)];
+		for (int j = 0; j <= D; j++) {
+			int i = span - D + j;
+			T wj = w ? w[i] : T(1);
+			for (int k = 0; k < chunk; k++) {
+				dw[j][k] = wj;
+				dx[j][k] = x[i] * wj;
+				dy[j][k] = y[i] * wj;
+			}
+		}
+		for (int r = 1; r <= D; r++) {
+			for (int j = D; j >= r; j--) {
+				for (int k = 0; k < chunk; k++) {
+					T a = (tk[k] - ui[j]) * inv[r][j];
+					dx[j][k] = dx[j - 1][k] + a * (dx[j][k] - dx[j - 1][k]);
+					dy[j][k] = dy[j - 1][k] + a * (dy[j][k] - dy[j - 1][k]);
+					dw[j][k] = dw[j - 1][k] + a * (dw[j][k] - dw[j - 1][k]);
+				}
+			}
+		}
+		for (int k = 0; k < c; k++) {
+			px[k0 + k] = dx[D][k] / dw[D][k];
+			py[k0 + k] = dy[D][k] / dw[D][k];
+		}
+	}
+}
+
+// Boehm's algorithm, inserts t into the knots u of the B-spline of degree D over x, y and the
+// weights w. The curve keeps its shape and gains the control point returned, the D - 1 points
+// before it move onto the finer polygon.
+template<int D>
+int InsertKnot(std::vector<float>& u, std::vector<float>& x, std::vector<float>& y, std::vector<float>& w, float t);
+
+// B-spline or NURBS curve over a control polygon, sampled per span. A control point supports
+// degree + 1 spans, so moving it or changing its weight evaluates only those again.
+struct BSplineCache {
+	int degree{ 3 };
+	// control points and their weights, the curve is rational unless all are 1
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> w;
+	// clamped knots, points() + degree + 1 of them with the first and last degree + 1 equal
+	std::vector<float> u;
+	// span i runs over u[degree + i]..u[degree + i + 1], its samples are
+	// [i * per_span, (i + 1) * per_span) of sx, sy and the next one closes it, the last sample
+	// is the end of the curve
+	int per_span{ 16 };
+	std::vector<float> sx;
+	std::vector<float> sy;
+	// min x, min y, max x, max y of the control points of every span, the span lies in their
+	// convex hull as long as the weights are positive
+	std::vector<float> box;
+
+	int points() const { return (int)x.size(); }
+	int spans() const { return points() > degree ? points() - degree : 0; }
+
+	// control points with the weights w, all 1 if w is null. Knots and samples are up to the caller.
+	void assign(const float* x, const float* y, const float* w, int n, int degree);
+};
+
+// clamped knots of the control polygon, uniform for param_type 0 and otherwise the parameters
+// of the points (see ParamFunc) averaged over degree points at a time
+void BSplineKnots(BSplineCache& s, int param_type);
+
+// evaluate every span, per_span samples each
+void SampleBSpline(BSplineCache& s, int per_span);
+// evaluate spans first..last again, and update their bounds
+void SampleSpans(BSplineCache& s, int first, int last);
+
+// the spans first..last that control point k takes part in
+void SupportSpans(const BSplineCache& s, int k, int& first, int& last);
+
+// control point k moves to x, y with the weight w, the knots stay. Only the spans of its support
+// are evaluated again, they are returned in first..last.
+void MoveControlPoint(BSplineCache& s, int k, float x, float y, float w, int& first, int& last);
+
+// insert the knot t, returns the new control point. The curve does not change, the span that
+// holds t is split in two and sampled again.
+int InsertKnot(BSplineCache& s, float t);
+
+// parameter of the sample nearest to x, y
+float ClosestSample(const BSplineCache& s, float x, float y);
+// parameter at the fraction f of the way from sample q to the next
+float SampleParameter(const BSplineCache& s, int q, float f);
+
+// f(i) for every span whose bounds overlap [x0, x1] x [y0, y1]
+template<typename F>
+void ForEachVisible(const BSplineCache& s, float x0, float y0, float x1, float y1, F&& f) {
+	for (int i = 0; i < s.spans(); i++) {
+		const float* b = &s.box[4 * i];
+		if (b[0] <= x1 && b[2] >= x0 && b[1] <= y1 && b[3] >= y0)
+			f(i);
+	}
+}
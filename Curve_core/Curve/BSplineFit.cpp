@@ -0,0 +1,210 @@
+#include "BSplineFit.h"
+
+#include "FrameArena.h"
+#include "Parameterization.h"
+#include "Tridiagonal.h"
+
+#include <algorithm>
+#include <cmath>
+
+// share of the knot mass that comes from the turning of the points, the rest from their parameters
+constexpr double bend_share = 0.5;
+// no two knots closer than this fraction of an even spacing
+constexpr float min_gap = 0.1f;
+// bending energy that is always there so that spans without points are still solvable, relative
+// to the data term it is weighed against: about n / m per control point against m^3 for the
+// bending of an even span
+constexpr double min_bending = 1e-9;
+
+// the 4 cubic basis functions that are nonzero on span at t, N[j] for control point span - 3 + j,
+// by the triangle of the Cox-de Boor recurrence
+static void cubicBasis(const float* u, int span, float t, double* N) {
+	double left[4], right[4];
+	N[0] = 1.;
+	for (int j = 1; j <= 3; j++) {
+		left[j] = (double)t - u[span + 1 - j];
+		right[j] = (double)u[span + j] - t;
+		double saved = 0.;
+		for (int r = 0; r < j; r++) {
+			double tmp = N[r] / (right[r + 1] + left[j - r]);
+			N[r] = saved + right[r + 1] * tmp;
+			saved = left[j - r] * tmp;
+		}
+		N[j] = saved;
+	}
+}
+
+// the basis functions of span i as cubics in s = 3 (t - u[i]) / (u[i + 1] - u[i]), c[4 j + k] is
+// the coefficient of s^k of N[j]. They go through their values at s = 0..3, by forward differences.
+static void spanPolynomials(const float* u, int i, double* c) {
+	double v[4][4];
+	for (int q = 0; q < 4; q++)
+		cubicBasis(u, i, (float)(u[i] + q / 3. * ((double)u[i + 1] - u[i])), v[q]);
+	for (int j = 0; j < 4; j++) {
+		double d1 = v[1][j] - v[0][j];
+		double d2 = v[2][j] - 2. * v[1][j] + v[0][j];
+		double d3 = v[3][j] - 3. * v[2][j] + 3. * v[1][j] - v[0][j];
+		c[4 * j] = v[0][j];
+		c[4 * j + 1] = d1 - d2 / 2. + d3 / 3.;
+		c[4 * j + 2] = d2 / 2. - d3 / 2.;
+		c[4 * j + 3] = d3 / 6.;
+	}
+}
+
+// the second derivative control point i of the cubic B-spline on the knots u,
+//   P''_i = c[0] P_i + c[1] P_{i + 1} + c[2] P_{i + 2},
+// the difference of the first derivative points, which are differences of the control points
+inline void secondDifference(const float* u, int i, double* c) {
+	double c1 = 3. / ((double)u[i + 4] - u[i + 1]);
+	double c2 = 3. / ((double)u[i + 5] - u[i + 2]);
+	double e = 2. / ((double)u[i + 4] - u[i + 2]);
+	c[0] = e * c1;
+	c[1] = -e * (c1 + c2);
+	c[2] = e * c2;
+}
+
+// the clamped knots u of m control points over the parameters t in [0, 1]. The interior knots
+// split the mass of parameter and turning evenly, with the turning taken over a quarter of an even
+// span so that the noise between neighbouring points does not count.
+static void fitKnots(const float* x, const float* y, const float* t, int n, int m, float* u, FrameArena& arena) {
+	for (int i = 0; i < 4; i++) {
+		u[i] = 0.f;
+		u[m + i] = 1.f;
+	}
+	int spans = m - 3;
+	if (spans == 1)
+		return;
+	int k = std::max(1, n / (4 * spans));
+	// which changes little from one point to the next, it is taken at every stride-th point
+	int stride = std::max(1, k / 4);
+	float* bend = arena.alloc<float>(n);
+	double total = 0.;
+	for (int j = 0; j < n; j++) {
+		bend[j] = 0.f;
+		if (j < k || j + k >= n)
+			continue;
+		if (j % stride != 0 && j > k) {
+			bend[j] = bend[j - 1];
+		}
+		else {
+			float ax = x[j] - x[j - k], ay = y[j] - y[j - k];
+			float bx = x[j + k] - x[j], by = y[j + k] - y[j];
+			bend[j] = std::fabs(std::atan2(ax * by - ay * bx, ax * bx + ay * by));
+		}
+		total += bend[j];
+	}
+	double share = total > 0. ? bend_share : 0.;
+	double scale = total > 0. ? share / total : 0.;
+	// mass up to point j + 1 against the target of knot i, both running forward
+	double mass = 0.;
+	int j = 0;
+	for (int i = 1; i < spans; i++) {
+		double target = (double)i / spans;
+		for (; j < n - 1; j++) {
+			double step = (1. - share) * ((double)t[j + 1] - t[j]) + scale * 0.5 * ((double)bend[j] + bend[j + 1]);
+			if (mass + step >= target) {
+				double f = step > 0. ? (target - mass) / step : 0.;
+				u[3 + i] = (float)(t[j] + f * ((double)t[j + 1] - t[j]));
+				break;
+			}
+			mass += step;
+		}
+		if (j == n - 1)
+			u[3 + i] = 1.f;
+	}
+	// spans of at least min_gap of an even one, forward and then back from the end
+	float gap = min_gap / spans;
+	for (int i = 4; i < m; i++)
+		u[i] = std::max(u[i], u[i - 1] + gap);
+	for (int i = m - 1; i >= 4; i--)
+		u[i] = std::min(u[i], u[i + 1] - gap);
+}
+
+bool FitBSpline(const float* x, const float* y, int n, int m, float smoothing, int param_type, BSplineCache& s, FrameArena& arena) {
+	if (n < 2 || m < 4)
+		return false;
+	float* h = arena.alloc<float>(n - 1);
+	float* t = arena.alloc<float>(n);
+	ParamFunc[param_type](x, y, n, h, 0, n - 2);
+	Knots(h, n, t);
+	// the chordal parameters are the length already
+	double len = t[n - 1];
+	if (param_type != 1) {
+		len = 0.;
+		for (int j = 0; j + 1 < n; j++)
+			len += std::sqrt((x[j + 1] - x[j]) * (x[j + 1] - x[j]) + (y[j + 1] - y[j]) * (y[j + 1] - y[j]));
+	}
+	if (!(t[n - 1] > 0.f) || !(len > 0.))
+		return false;
+	float inv = 1.f / t[n - 1];
+	for (int j = 0; j < n; j++)
+		t[j] *= inv;
+	t[n - 1] = 1.f;
+
+	s.degree = 3;
+	s.u.resize(m + 4);
+	float* u = s.u.data();
+	fitKnots(x, y, t, n, m, u, arena);
+
+	// the normal equations, row i holds a[4 i + k] = A(i, i - k)
+	double* a = arena.alloc<double>(4 * m);
+	double* bx = arena.alloc<double>(m);
+	double* by = arena.alloc<double>(m);
+	std::fill(a, a + 4 * m, 0.);
+	std::fill(bx, bx + m, 0.);
+	std::fill(by, by + m, 0.);
+	// the parameters increase, so do their spans. The basis functions of a span are turned into
+	// polynomials once, a point takes 4 Horner steps instead of the divisions of the recurrence.
+	int span = 3;
+	double c[16];
+	spanPolynomials(u, span, c);
+	double scale = 3. / ((double)u[4] - u[3]);
+	for (int j = 0; j < n; j++) {
+		if (span < m - 1 && t[j] >= u[span + 1]) {
+			while (span < m - 1 && t[j] >= u[span + 1])
+				span++;
+			spanPolynomials(u, span, c);
+			scale = 3. / ((double)u[span + 1] - u[span]);
+		}
+		double v = ((double)t[j] - u[span]) * scale;
+		double N[4];
+		for (int p = 0; p < 4; p++)
+			N[p] = ((c[4 * p + 3] * v + c[4 * p + 2]) * v + c[4 * p + 1]) * v + c[4 * p];
+		double* row = a + 4 * (span - 3);
+		for (int p = 0; p < 4; p++) {
+			bx[span - 3 + p] += N[p] * x[j];
+			by[span - 3 + p] += N[p] * y[j];
+			for (int q = 0; q <= p; q++)
+				row[4 * p + p - q] += N[p] * N[q];
+		}
+	}
+	// the bending energy. C'' is linear on a span, P''_{i - 3} at its start and P''_{i - 2} at its
+	// end, and the integral of the product of two linear functions is exact from their end values.
+	double m4 = (double)m * m * m * m;
+	double lambda = n * ((double)smoothing / (len * len) + min_bending / m4);
+	for (int i = 3; i < m; i++) {
+		double d = (double)u[i + 1] - u[i];
+		double l[4] = { 0., 0., 0., 0. }, r[4] = { 0., 0., 0., 0. };
+		secondDifference(u, i - 3, l);
+		secondDifference(u, i - 2, r + 1);
+		double f = lambda * d / 6.;
+		double* row = a + 4 * (i - 3);
+		for (int p = 0; p < 4; p++) {
+			for (int q = 0; q <= p; q++)
+				row[4 * p + p - q] += f * (2. * l[p] * l[q] + l[p] * r[q] + r[p] * l[q] + 2. * r[p] * r[q]);
+		}
+	}
+	if (!CholeskyBand(a, m, 3))
+		return false;
+	SolveCholeskyBand(a, m, 3, bx);
+	SolveCholeskyBand(a, m, 3, by);
+
+	s.x.resize(m);
+	s.y.resize(m);
+	s.w.assign(m, 1.f);
+	for (int i = 0; i < m; i++) {
+		s.x[i] = (float)bx[i];
+		s.y[i] = (float)by[i];
+	}
+	return true;
+}
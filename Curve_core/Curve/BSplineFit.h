@@ -0,0 +1,17 @@
+#pragma once
+
+#include "BSpline.h"
+
+struct FrameArena;
+
+// the cubic B-spline with m >= 4 control points that approximates the n points x, y in the
+// penalized least squares sense, into s with its knots. The points get parameters in [0, 1] by
+// param_type (see ParamFunc), and the spline minimizes
+//   sum |C(t_j) - p_j|^2 + n smoothing L integral |C''(s)|^2 ds
+// over the arc length s of a curve of length L, so smoothing is the squared distance per point
+// that one unit of bending is worth, 0 for a plain least squares fit. The interior knots split a
+// mass that grows with the parameter and with the turning of the points evenly, so the spans
+// are shorter where the points bend. Each point touches 4 control points and each span 4, the
+// normal equations are a band of 3 on either side of the diagonal, assembled and solved by
+// Cholesky in O(n + m). False if there are too few points or they all coincide.
+bool FitBSpline(const float* x, const float* y, int n, int m, float smoothing, int param_type, BSplineCache& s, FrameArena& arena);
@@ -0,0 +1,79 @@
+#include "Bezier.h"
+
+#include <algorithm>
+
+// deeper pieces are 1 / 2^16 of the curve and always accepted
+constexpr int max_depth = 16;
+
+// the curve stays within sqrt(flatness / 16) of its chord
+inline float flatness(const float* c) {
+	float ux = 3.f * c[1] - 2.f * c[0] - c[3];
+	float uy = 3.f * c[5] - 2.f * c[4] - c[7];
+	float vx = 3.f * c[2] - c[0] - 2.f * c[3];
+	float vy = 3.f * c[6] - c[4] - 2.f * c[7];
+	return std::max(ux * ux, vx * vx) + std::max(uy * uy, vy * vy);
+}
+
+// split c at t = 0.5 into l and r, c holds x0..x3 then y0..y3
+inline void split(const float* c, float* l, float* r) {
+	for (int k = 0; k < 8; k += 4) {
+		float p01 = 0.5f * (c[k] + c[k + 1]);
+		float p12 = 0.5f * (c[k + 1] + c[k + 2]);
+		float p23 = 0.5f * (c[k + 2] + c[k + 3]);
+		float p012 = 0.5f * (p01 + p12);
+		float p123 = 0.5f * (p12 + p23);
+		float mid = 0.5f * (p012 + p123);
+		l[k] = c[k]; l[k + 1] = p01; l[k + 2] = p012; l[k + 3] = mid;
+		r[k] = mid; r[k + 1] = p123; r[k + 2] = p23; r[k + 3] = c[k + 3];
+	}
+}
+
+// emit(x, y) for the start of every piece, depth first with the left half on top so the
+// pieces come out in order
+template<typename F>
+void forEachPiece(const float* px, const float* py, float tol, F&& emit) {
+	const float limit = 16.f * tol * tol;
+	float stack[max_depth + 1][8];
+	int depth[max_depth + 1];
+	int top = 0;
+	std::copy(px, px + 4, stack[0]);
+	std::copy(py, py + 4, stack[0] + 4);
+	depth[0] = 0;
+	while (top >= 0) {
+		float* c = stack[top];
+		int d = depth[top];
+		if (d == max_depth || flatness(c) <= limit) {
+			emit(c[0], c[4]);
+			--top;
+			continue;
+		}
+		float l[8];
+		split(c, l, stack[top]);
+		depth[top] = d + 1;
+		++top;
+		std::copy(l, l + 8, stack[top]);
+		depth[top] = d + 1;
+	}
+}
+
+void TessellateBezier(const float* px, const float* py, float tol, std::vector<float>& sx, std::vector<float>& sy) {
+	forEachPiece(px, py, tol, [&](float x, float y) {
+		sx.push_back(x);
+		sy.push_back(y);
+	});
+}
+
+int BezierPieces(const float* px, const float* py, float tol) {
+	int count = 0;
+	forEachPiece(px, py, tol, [&](float, float) { count++; });
+	return count;
+}
+
+void TessellateBezier(const float* px, const float* py, float tol, float* sx, float* sy) {
+	int j = 0;
+	forEachPiece(px, py, tol, [&](float x, float y) {
+		sx[j] = x;
+		sy[j] = y;
+		j++;
+	});
+}
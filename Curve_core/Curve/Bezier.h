@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+
+// adaptive tessellation of one cubic Bezier with control points (px[i], py[i]).
+// Subdivides until every piece lies within tol of its chord and appends the start of
+// each piece to sx, sy, so the samples cover [0, 1) and the end point is left to the caller.
+void TessellateBezier(const float* px, const float* py, float tol, std::vector<float>& sx, std::vector<float>& sy);
+
+// number of samples TessellateBezier produces
+int BezierPieces(const float* px, const float* py, float tol);
+// the same samples written to sx, sy, which hold BezierPieces of them
+void TessellateBezier(const float* px, const float* py, float tol, float* sx, float* sy);
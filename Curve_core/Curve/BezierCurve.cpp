@@ -0,0 +1,59 @@
+#include "BezierCurve.h"
+
+#include <utility>
+
+template<int N>
+static void sampleBezier(const float* x, const float* y, int m, float* sx, float* sy) {
+	BezierCurve<N> b;
+	b.assign(x, y);
+	// sx holds the parameters, every chunk of them is read before its samples are written
+	float step = 1.f / (m - 1);
+	for (int j = 0; j < m; j++)
+		sx[j] = step * j;
+	b.eval(sx, m, sx, sy);
+	// the curve ends in its end points
+	sx[0] = x[0], sy[0] = y[0];
+	sx[m - 1] = x[N], sy[m - 1] = y[N];
+}
+
+template<int N>
+static void elevateBezier(const float* x, const float* y, float* ex, float* ey) {
+	BezierCurve<N> b;
+	b.assign(x, y);
+	BezierCurve<N + 1> e = b.elevate();
+	for (int i = 0; i <= N + 1; i++) {
+		ex[i] = e.x[i];
+		ey[i] = e.y[i];
+	}
+}
+
+// entry D - 1 of the tables is the instantiation for degree D
+using SampleFunc = void (*)(const float*, const float*, int, float*, float*);
+using ElevateFunc = void (*)(const float*, const float*, float*, float*);
+
+template<int... D>
+constexpr std::array<SampleFunc, sizeof...(D)> sampleTable(std::integer_sequence<int, D...>) {
+	return { { &sampleBezier<D + 1>... } };
+}
+
+template<int... D>
+constexpr std::array<ElevateFunc, sizeof...(D)> elevateTable(std::integer_sequence<int, D...>) {
+	return { { &elevateBezier<D + 1>... } };
+}
+
+static constexpr auto sample_table = sampleTable(std::make_integer_sequence<int, bezier_max_degree>());
+static constexpr auto elevate_table = elevateTable(std::make_integer_sequence<int, bezier_max_degree - 1>());
+
+bool SampleBezier(const float* x, const float* y, int n, int m, float* sx, float* sy) {
+	if (n < 2 || n > bezier_max_degree + 1 || m < 2)
+		return false;
+	sample_table[n - 2](x, y, m, sx, sy);
+	return true;
+}
+
+bool ElevateBezier(const float* x, const float* y, int n, float* ex, float* ey) {
+	if (n < 2 || n > bezier_max_degree)
+		return false;
+	elevate_table[n - 2](x, y, ex, ey);
+	return true;
+}
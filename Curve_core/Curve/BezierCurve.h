@@ -0,0 +1,248 @@
+#pragma once
+
+#include <array>
+
+// degrees the runtime dispatch of SampleBezier is instantiated for
+constexpr int bezier_max_degree = 15;
+
+// C(N, 0)..C(N, N), exact in T up to N = 24 for float and 53 for double
+template<int N, typename T>
+constexpr std::array<T, N + 1> BinomialRow() {
+	std::array<T, N + 1> c{};
+	long long b = 1;
+	for (int k = 0; k <= N; k++) {
+		c[k] = (T)b;
+		b = b * (N - k) / (k + 1);
+	}
+	return c;
+}
+
+// x^N by repeated squaring, the multiplications unroll for a constant N
+template<int N, typename T>
+constexpr T IntPow(T x) {
+	T r = T(1);
+	for (int n = N; n > 0; n >>= 1, x *= x) {
+		if (n & 1)
+			r *= x;
+	}
+	return r;
+}
+
+// Bezier curve of degree N over the control points (x[i], y[i]). Every loop has a trip count known
+// at compile time, the binomials are constants.
+template<int N, typename T = float>
+struct BezierCurve {
+	static_assert(N >= 1, "a Bezier curve has at least degree 1");
+	static constexpr int degree = N;
+	static constexpr std::array<T, N + 1> binomial = BinomialRow<N, T>();
+
+	T x[N + 1];
+	T y[N + 1];
+
+	void assign(const T* px, const T* py) {
+		for (int i = 0; i <= N; i++) {
+			x[i] = px[i];
+			y[i] = py[i];
+		}
+	}
+
+	// de Casteljau's algorithm, N (N + 1) / 2 linear interpolations
+	void eval(T t, T& px, T& py) const {
+		T bx[N + 1], by[N + 1];
+		for (int i = 0; i <= N; i++) {
+			bx[i] = x[i];
+			by[i] = y[i];
+		}
+		for (int r = 1; r <= N; r++) {
+			for (int i = 0; i <= N - r; i++) {
+				bx[i] += t * (bx[i + 1] - bx[i]);
+				by[i] += t * (by[i + 1] - by[i]);
+			}
+		}
+		px = bx[0];
+		py = by[0];
+	}
+
+	// the Bernstein form in Horner's scheme, N multiply-adds. On t <= 1/2 it is a polynomial in
+	// s = t / (1 - t) times (1 - t)^N, on the other half the mirror of that, so s never exceeds 1.
+	void evalHorner(T t, T& px, T& py) const {
+		T ax, ay;
+		if (t <= T(0.5)) {
+			T u = T(1) - t, s = t / u;
+			ax = x[N], ay = y[N];
+			for (int i = N - 1; i >= 0; i--) {
+				ax = ax * s + binomial[i] * x[i];
+				ay = ay * s + binomial[i] * y[i];
+			}
+			T f = IntPow<N>(u);
+			px = ax * f, py = ay * f;
+		}
+		else {
+			T s = (T(1) - t) / t;
+			ax = x[0], ay = y[0];
+			for (int i = 1; i <= N; i++) {
+				ax = ax * s + binomial[i] * x[i];
+				ay = ay * s + binomial[i] * y[i];
+			}
+			T f = IntPow<N>(t);
+			px = ax * f, py = ay * f;
+		}
+	}
+
+	// the curve at the m parameters t. They go through de Casteljau's algorithm chunk at a time,
+	// one lane each, so that the innermost loops vectorize.
+	void eval(const T* t, int m, T* px, T* py) const {
+		constexpr int chunk = 16;
+		for (int k0 = 0; k0 < m; k0 += chunk) {
+			int c = m - k0 < chunk ? m - k0 : chunk;
+			T tk[chunk], bx[N + 1][chunk], by[N + 1][chunk];
+			for (int k = 0; k < chunk; k++)
+				tk[k] = t[k0 + (k < c ? k : 0)];
+			for (int i = 0; i <= N; i++) {
+				for (int k = 0; k < chunk; k++) {
+					bx[i][k] = x[i];
+					by[i][k] = y[i];
+				}
+			}
+			for (int r = 1; r <= N; r++) {
+				for (int i = 0; i <= N - r; i++) {
+					for (int k = 0; k < chunk; k++) {
+						bx[i][k] += tk[k] * (bx[i + 1][k] - bx[i][k]);
+						by[i][k] += tk[k] * (by[i + 1][k] - by[i][k]);
+					}
+				}
+			}
+			for (int k = 0; k < c; k++) {
+				px[k0 + k] = bx[0][k];
+				py[k0 + k] = by[0][k];
+			}
+		}
+	}
+
+	// the same curve as l on [0, t] and r on [t, 1], the two sides of the de Casteljau triangle
+	void split(T t, BezierCurve& l, BezierCurve& r) const {
+		T bx[N + 1], by[N + 1];
+		for (int i = 0; i <= N; i++) {
+			bx[i] = x[i];
+			by[i] = y[i];
+		}
+		l.x[0] = bx[0], l.y[0] = by[0];
+		r.x[N] = bx[N], r.y[N] = by[N];
+		for (int k = 1; k <= N; k++) {
+			for (int i = 0; i <= N - k; i++) {
+				bx[i] += t * (bx[i + 1] - bx[i]);
+				by[i] += t * (by[i + 1] - by[i]);
+			}
+			l.x[k] = bx[0], l.y[k] = by[0];
+			r.x[N - k] = bx[N - k], r.y[N - k] = by[N - k];
+		}
+	}
+
+	// the same curve with one more control point
+	BezierCurve<N + 1, T> elevate() const {
+		BezierCurve<N + 1, T> e;
+		e.x[0] = x[0], e.y[0] = y[0];
+		e.x[N + 1] = x[N], e.y[N + 1] = y[N];
+		for (int i = 1; i <= N; i++) {
+			T a = T(i) / T(N + 1);
+			e.x[i] = a * x[i - 1] + (T(1) - a) * x[i];
+			e.y[i] = a * y[i - 1] + (T(1) - a) * y[i];
+		}
+		return e;
+	}
+
+	// power basis, x(t) = ax[0] + ax[1] t + .. + ax[N] t^N for Horner's scheme in t. The
+	// coefficients are C(N, k) times the k-th forward difference of the control points, they
+	// cancel more and more with the degree, so this is for low degrees.
+	void power(T* ax, T* ay) const {
+		T dx[N + 1], dy[N + 1];
+		for (int i = 0; i <= N; i++) {
+			dx[i] = x[i];
+			dy[i] = y[i];
+		}
+		for (int k = 0; k <= N; k++) {
+			ax[k] = binomial[k] * dx[0];
+			ay[k] = binomial[k] * dy[0];
+			for (int i = 0; i < N - k; i++) {
+				dx[i] = dx[i + 1] - dx[i];
+				dy[i] = dy[i + 1] - dy[i];
+			}
+		}
+	}
+};
+
+// m curves of degree N stored by columns, control point i of curve c is x[i * m + c]. Every curve
+// at the same t into px, py, in the Bernstein form of BezierCurve::evalHorner. A chunk of curves
+// at a time takes one multiply-add per control point, the curves are the innermost loop.
+template<int N, typename T>
+void EvalBezierBatch(const T* x, const T* y, int m, T t, T* px, T* py) {
+	constexpr int chunk = 256;
+	constexpr auto binomial = BinomialRow<N, T>();
+	// the scheme runs from control point N down on the first half and from 0 up on the second
+	bool head = t <= T(0.5);
+	T s = head ? t / (T(1) - t) : (T(1) - t) / t;
+	T f = IntPow<N>(head ? T(1) - t : t);
+	for (int c0 = 0; c0 < m; c0 += chunk) {
+		int c = m - c0 < chunk ? m - c0 : chunk;
+		T* ax = px + c0;
+		T* ay = py + c0;
+		int j = head ? N : 0;
+		for (int k = 0; k < c; k++) {
+			ax[k] = x[j * m + c0 + k];
+			ay[k] = y[j * m + c0 + k];
+		}
+		for (int i = 1; i <= N; i++) {
+			j = head ? N - i : i;
+			const T* cx = x + j * m + c0;
+			const T* cy = y + j * m + c0;
+			T b = binomial[j];
+			for (int k = 0; k < c; k++) {
+				ax[k] = ax[k] * s + b * cx[k];
+				ay[k] = ay[k] * s + b * cy[k];
+			}
+		}
+		for (int k = 0; k < c; k++) {
+			ax[k] *= f;
+			ay[k] *= f;
+		}
+	}
+}
+
+// the same with curve c at t[c], by de Casteljau's algorithm with one curve per lane
+template<int N, typename T>
+void EvalBezierBatch(const T* x, const T* y, int m, const T* t, T* px, T* py) {
+	constexpr int chunk = 16;
+	for (int c0 = 0; c0 < m; c0 += chunk) {
+		int c = m - c0 < chunk ? m - c0 : chunk;
+		T tk[chunk], bx[N + 1][chunk], by[N + 1][chunk];
+		for (int k = 0; k < chunk; k++)
+			tk[k] = t[c0 + (k < c ? k : 0)];
+		for (int i = 0; i <= N; i++) {
+			for (int k = 0; k < chunk; k++) {
+				int q = i * m + c0 + (k < c ? k : 0);
+				bx[i][k] = x[q];
+				by[i][k] = y[q];
+			}
+		}
+		for (int r = 1; r <= N; r++) {
+			for (int i = 0; i <= N - r; i++) {
+				for (int k = 0; k < chunk; k++) {
+					bx[i][k] += tk[k] * (bx[i + 1][k] - bx[i][k]);
+					by[i][k] += tk[k] * (by[i + 1][k] - by[i][k]);
+				}
+			}
+		}
+		for (int k = 0; k < c; k++) {
+			px[c0 + k] = bx[0][k];
+			py[c0 + k] = by[0][k];
+		}
+	}
+}
+
+// the Bezier curve of degree n - 1 over the n points x, y at t = j / (m - 1) for j = 0..m-1 into
+// sx, sy, returns false unless 2 <= n <= bezier_max_degree + 1 and m >= 2
+bool SampleBezier(const float* x, const float* y, int n, int m, float* sx, float* sy);
+
+// the control points of the same curve one degree higher into ex, ey, which hold n + 1 of them,
+// returns false unless the elevated curve can still be sampled, 2 <= n <= bezier_max_degree
+bool ElevateBezier(const float* x, const float* y, int n, float* ex, float* ey);
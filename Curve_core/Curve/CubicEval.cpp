@@ -0,0 +1,128 @@
+#include "CubicEval.h"
+
+#include "BezierCurve.h"
+
+// the widest kernel the compiler is allowed to emit, AVX2 needs /arch:AVX2 or -mavx2 -mfma
+#if defined(__AVX2__) && defined(__FMA__) || defined(_MSC_VER) && defined(__AVX2__)
+#include <immintrin.h>
+#define CUBIC_EVAL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86_FP) && _M_IX86_FP >= 2
+#include <emmintrin.h>
+#define CUBIC_EVAL_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CUBIC_EVAL_NEON
+#endif
+
+CubicCoeffs HermiteCoeffs(float x0, float x1, float dx0, float dx1, float y0, float y1, float dy0, float dy1) {
+	CubicCoeffs c;
+	c.ax = x0;
+	c.bx = dx0;
+	c.cx = 3.f * (x1 - x0) - 2.f * dx0 - dx1;
+	c.dx = 2.f * (x0 - x1) + dx0 + dx1;
+	c.ay = y0;
+	c.by = dy0;
+	c.cy = 3.f * (y1 - y0) - 2.f * dy0 - dy1;
+	c.dy = 2.f * (y0 - y1) + dy0 + dy1;
+	return c;
+}
+
+CubicCoeffs BezierCoeffs(const float* px, const float* py) {
+	BezierCurve<3> b;
+	b.assign(px, py);
+	float ax[4], ay[4];
+	b.power(ax, ay);
+	return { ax[0], ax[1], ax[2], ax[3], ay[0], ay[1], ay[2], ay[3] };
+}
+
+// Horner form, shared by the scalar tails of every kernel
+inline void evalScalar(const CubicCoeffs& c, float t, float& x, float& y) {
+	x = ((c.dx * t + c.cx) * t + c.bx) * t + c.ax;
+	y = ((c.dy * t + c.cy) * t + c.by) * t + c.ay;
+}
+
+#if defined(CUBIC_EVAL_AVX2)
+
+constexpr int width = 8;
+
+inline void evalBlock(const CubicCoeffs& c, __m256 t, float* x, float* y) {
+	__m256 vx = _mm256_fmadd_ps(_mm256_set1_ps(c.dx), t, _mm256_set1_ps(c.cx));
+	vx = _mm256_fmadd_ps(vx, t, _mm256_set1_ps(c.bx));
+	vx = _mm256_fmadd_ps(vx, t, _mm256_set1_ps(c.ax));
+	__m256 vy = _mm256_fmadd_ps(_mm256_set1_ps(c.dy), t, _mm256_set1_ps(c.cy));
+	vy = _mm256_fmadd_ps(vy, t, _mm256_set1_ps(c.by));
+	vy = _mm256_fmadd_ps(vy, t, _mm256_set1_ps(c.ay));
+	_mm256_storeu_ps(x, vx);
+	_mm256_storeu_ps(y, vy);
+}
+
+inline __m256 loadT(const float* t) { return _mm256_loadu_ps(t); }
+inline __m256 rampT(int j, float step) {
+	return _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)j), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)), _mm256_set1_ps(step));
+}
+
+#elif defined(CUBIC_EVAL_SSE2)
+
+constexpr int width = 4;
+
+inline __m128 fmadd(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+inline void evalBlock(const CubicCoeffs& c, __m128 t, float* x, float* y) {
+	__m128 vx = fmadd(_mm_set1_ps(c.dx), t, _mm_set1_ps(c.cx));
+	vx = fmadd(vx, t, _mm_set1_ps(c.bx));
+	vx = fmadd(vx, t, _mm_set1_ps(c.ax));
+	__m128 vy = fmadd(_mm_set1_ps(c.dy), t, _mm_set1_ps(c.cy));
+	vy = fmadd(vy, t, _mm_set1_ps(c.by));
+	vy = fmadd(vy, t, _mm_set1_ps(c.ay));
+	_mm_storeu_ps(x, vx);
+	_mm_storeu_ps(y, vy);
+}
+
+inline __m128 loadT(const float* t) { return _mm_loadu_ps(t); }
+inline __m128 rampT(int j, float step) {
+	return _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)j), _mm_setr_ps(0, 1, 2, 3)), _mm_set1_ps(step));
+}
+
+#elif defined(CUBIC_EVAL_NEON)
+
+constexpr int width = 4;
+
+inline void evalBlock(const CubicCoeffs& c, float32x4_t t, float* x, float* y) {
+	float32x4_t vx = vmlaq_f32(vdupq_n_f32(c.cx), vdupq_n_f32(c.dx), t);
+	vx = vmlaq_f32(vdupq_n_f32(c.bx), vx, t);
+	vx = vmlaq_f32(vdupq_n_f32(c.ax), vx, t);
+	float32x4_t vy = vmlaq_f32(vdupq_n_f32(c.cy), vdupq_n_f32(c.dy), t);
+	vy = vmlaq_f32(vdupq_n_f32(c.by), vy, t);
+	vy = vmlaq_f32(vdupq_n_f32(c.ay), vy, t);
+	vst1q_f32(x, vx);
+	vst1q_f32(y, vy);
+}
+
+inline float32x4_t loadT(const float* t) { return vld1q_f32(t); }
+inline float32x4_t rampT(int j, float step) {
+	const float ramp[4] = { 0.f, 1.f, 2.f, 3.f };
+	return vmulq_n_f32(vaddq_f32(vdupq_n_f32((float)j), vld1q_f32(ramp)), step);
+}
+
+#endif
+
+void EvalCubic(const CubicCoeffs& c, const float* t, int n, float* x, float* y) {
+	int j = 0;
+#if defined(CUBIC_EVAL_AVX2) || defined(CUBIC_EVAL_SSE2) || defined(CUBIC_EVAL_NEON)
+	for (; j + width <= n; j += width)
+		evalBlock(c, loadT(t + j), x + j, y + j);
+#endif
+	for (; j < n; j++)
+		evalScalar(c, t[j], x[j], y[j]);
+}
+
+void EvalCubicUniform(const CubicCoeffs& c, int n, float* x, float* y) {
+	const float step = 1.f / n;
+	int j = 0;
+#if defined(CUBIC_EVAL_AVX2) || defined(CUBIC_EVAL_SSE2) || defined(CUBIC_EVAL_NEON)
+	for (; j + width <= n; j += width)
+		evalBlock(c, rampT(j, step), x + j, y + j);
+#endif
+	for (; j < n; j++)
+		evalScalar(c, j * step, x[j], y[j]);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// one cubic segment in power basis, x(t) = ax + bx t + cx t^2 + dx t^3 and the same for y.
+// Converting once per segment keeps the divisions and basis functions out of the sample loop.
+struct CubicCoeffs {
+	float ax, bx, cx, dx;
+	float ay, by, cy, dy;
+};
+
+// Hermite segment on t in [0, 1], the end slopes are already scaled by the interval
+CubicCoeffs HermiteCoeffs(float x0, float x1, float dx0, float dx1, float y0, float y1, float dy0, float dy1);
+
+// cubic Bezier with control points (px[i], py[i])
+CubicCoeffs BezierCoeffs(const float* px, const float* py);
+
+// evaluate at the n parameters t into SoA x, y
+void EvalCubic(const CubicCoeffs& c, const float* t, int n, float* x, float* y);
+
+// evaluate at t = j / n for j = 0..n-1 into SoA x, y
+void EvalCubicUniform(const CubicCoeffs& c, int n, float* x, float* y);
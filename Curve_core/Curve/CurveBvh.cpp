@@ -0,0 +1,220 @@
+#include "CurveBvh.h"
+
+#include "BezierCurve.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+constexpr float inf = std::numeric_limits<float>::infinity();
+// samples that pick the start of the projection onto a segment, and the Newton steps after
+constexpr int seed_samples = 16;
+constexpr int newton_steps = 24;
+// leaves refit per piece of a ParallelFor
+constexpr int grain = 1024;
+
+// squared distance from px, py to the box b, 0 inside of it
+inline float boxDist2(const float* b, float px, float py) {
+	float dx = std::max(std::max(b[0] - px, px - b[2]), 0.f);
+	float dy = std::max(std::max(b[1] - py, py - b[3]), 0.f);
+	return dx * dx + dy * dy;
+}
+
+// squared distance from px, py to the cubic with control points cx, cy, the t and point of the
+// curve it is taken at go to t, qx, qy
+static float project(const float* cx, const float* cy, float px, float py, float& t, float& qx, float& qy) {
+	// relative to the query, the coordinates stay small where the distance is
+	BezierCurve<3> b;
+	for (int i = 0; i < 4; i++) {
+		b.x[i] = cx[i] - px;
+		b.y[i] = cy[i] - py;
+	}
+	float ax[4], ay[4];
+	b.power(ax, ay);
+	auto dist2 = [&](float s) {
+		float ex = ((ax[3] * s + ax[2]) * s + ax[1]) * s + ax[0];
+		float ey = ((ay[3] * s + ay[2]) * s + ay[1]) * s + ay[0];
+		return ex * ex + ey * ey;
+	};
+	// Newton's method on e(s) . e'(s), half the derivative of the squared distance, from every
+	// sample closer than its neighbours. The minimum stays between the neighbours, a step that
+	// leaves that bracket or goes uphill halves it instead.
+	auto newton = [&](float s) {
+		float lo = std::max(s - 1.f / seed_samples, 0.f), hi = std::min(s + 1.f / seed_samples, 1.f);
+		for (int k = 0; k < newton_steps; k++) {
+			float ex = ((ax[3] * s + ax[2]) * s + ax[1]) * s + ax[0];
+			float ey = ((ay[3] * s + ay[2]) * s + ay[1]) * s + ay[0];
+			float dx = (3.f * ax[3] * s + 2.f * ax[2]) * s + ax[1];
+			float dy = (3.f * ay[3] * s + 2.f * ay[2]) * s + ay[1];
+			float ddx = 6.f * ax[3] * s + 2.f * ax[2];
+			float ddy = 6.f * ay[3] * s + 2.f * ay[2];
+			float f = ex * dx + ey * dy;
+			float df = dx * dx + dy * dy + ex * ddx + ey * ddy;
+			if (f == 0.f)
+				break;
+			if (f > 0.f)
+				hi = s;
+			else
+				lo = s;
+			float next = df > 0.f ? s - f / df : 0.5f * (lo + hi);
+			if (!(next >= lo && next <= hi))
+				next = 0.5f * (lo + hi);
+			bool done = std::fabs(next - s) < 1e-6f;
+			s = next;
+			if (done)
+				break;
+		}
+		return s;
+	};
+	float d[seed_samples + 1];
+	for (int k = 0; k <= seed_samples; k++)
+		d[k] = dist2((float)k / seed_samples);
+	float s = 0.f, best = d[0];
+	for (int k = 0; k <= seed_samples; k++) {
+		if ((k > 0 && d[k] > d[k - 1]) || (k < seed_samples && d[k] > d[k + 1]))
+			continue;
+		float seed = (float)k / seed_samples;
+		// a step may run into another valley, the seed is kept then
+		float r = newton(seed), dr = dist2(r);
+		if (!(dr <= d[k]))
+			r = seed, dr = d[k];
+		if (dr < best)
+			s = r, best = dr;
+	}
+	t = s;
+	qx = ((ax[3] * s + ax[2]) * s + ax[1]) * s + ax[0] + px;
+	qy = ((ay[3] * s + ay[2]) * s + ay[1]) * s + ay[0] + py;
+	return best;
+}
+
+void CurveBvh::build(const float* cx, const float* cy, int m) {
+	x.assign(cx, cx + 4 * m);
+	y.assign(cy, cy + 4 * m);
+	layout();
+}
+
+void CurveBvh::buildPolyline(const float* px, const float* py, int n) {
+	int m = std::max(n - 1, 0);
+	x.resize(4 * m);
+	y.resize(4 * m);
+	for (int i = 0; i < m; i++) {
+		float dx = (px[i + 1] - px[i]) / 3.f, dy = (py[i + 1] - py[i]) / 3.f;
+		x[4 * i] = px[i], x[4 * i + 1] = px[i] + dx, x[4 * i + 2] = px[i + 1] - dx, x[4 * i + 3] = px[i + 1];
+		y[4 * i] = py[i], y[4 * i + 1] = py[i] + dy, y[4 * i + 2] = py[i + 1] - dy, y[4 * i + 3] = py[i + 1];
+	}
+	layout();
+}
+
+void CurveBvh::update(int first, int last, const float* cx, const float* cy) {
+	std::copy(cx, cx + 4 * (last - first + 1), x.begin() + 4 * first);
+	std::copy(cy, cy + 4 * (last - first + 1), y.begin() + 4 * first);
+	refit(first / leaf, last / leaf);
+}
+
+void CurveBvh::clear() {
+	x.clear();
+	y.clear();
+	box.clear();
+	leaves = 0;
+}
+
+void CurveBvh::layout() {
+	int used = (segments() + leaf - 1) / leaf;
+	leaves = 1;
+	while (leaves < used)
+		leaves *= 2;
+	box.resize(4 * (2 * leaves - 1));
+	refit(0, leaves - 1);
+}
+
+void CurveBvh::refit(int a, int b) {
+	int m = segments();
+	ParallelFor(b - a + 1, grain, [&](int begin, int end) {
+		for (int l = a + begin; l < a + end; l++) {
+			float* bx = &box[4 * (leaves - 1 + l)];
+			bx[0] = bx[1] = inf;
+			bx[2] = bx[3] = -inf;
+			int q_end = 4 * std::min((l + 1) * leaf, m);
+			for (int q = 4 * l * leaf; q < q_end; q++) {
+				bx[0] = std::min(bx[0], x[q]);
+				bx[1] = std::min(bx[1], y[q]);
+				bx[2] = std::max(bx[2], x[q]);
+				bx[3] = std::max(bx[3], y[q]);
+			}
+		}
+	});
+	// the parents of the nodes lo..hi, one level at a time
+	int lo = leaves - 1 + a, hi = leaves - 1 + b;
+	while (lo > 0) {
+		lo = (lo - 1) / 2;
+		hi = (hi - 1) / 2;
+		for (int k = lo; k <= hi; k++) {
+			float* p = &box[4 * k];
+			const float* l = &box[4 * (2 * k + 1)];
+			const float* r = &box[4 * (2 * k + 2)];
+			p[0] = std::min(l[0], r[0]);
+			p[1] = std::min(l[1], r[1]);
+			p[2] = std::max(l[2], r[2]);
+			p[3] = std::max(l[3], r[3]);
+		}
+	}
+}
+
+bool CurveBvh::nearest(float px, float py, float max_dist, CurveHit& hit) const {
+	int m = segments();
+	if (m == 0)
+		return false;
+	float best = max_dist * max_dist;
+	bool found = false;
+	// nodes still to visit and the squared distance to their boxes, the nearer child on top.
+	// Every level leaves at most one node behind.
+	constexpr int max_depth = 32;
+	int stack[max_depth + 1];
+	float stack_d[max_depth + 1];
+	int top = 0;
+	stack[top] = 0;
+	stack_d[top++] = boxDist2(&box[0], px, py);
+	while (top > 0) {
+		top--;
+		int k = stack[top];
+		if (stack_d[top] >= best)
+			continue;
+		if (k >= leaves - 1) {
+			int l = k - (leaves - 1);
+			for (int i = l * leaf; i < std::min((l + 1) * leaf, m); i++) {
+				// the segment lies in the box of its control points
+				const float* cx = &x[4 * i];
+				const float* cy = &y[4 * i];
+				float b[4] = {
+					std::min(std::min(cx[0], cx[1]), std::min(cx[2], cx[3])),
+					std::min(std::min(cy[0], cy[1]), std::min(cy[2], cy[3])),
+					std::max(std::max(cx[0], cx[1]), std::max(cx[2], cx[3])),
+					std::max(std::max(cy[0], cy[1]), std::max(cy[2], cy[3])),
+				};
+				if (boxDist2(b, px, py) >= best)
+					continue;
+				float t, qx, qy;
+				float d = project(cx, cy, px, py, t, qx, qy);
+				if (d < best) {
+					best = d;
+					hit.segment = i, hit.t = t, hit.x = qx, hit.y = qy;
+					found = true;
+				}
+			}
+			continue;
+		}
+		int c0 = 2 * k + 1, c1 = 2 * k + 2;
+		float d0 = boxDist2(&box[4 * c0], px, py);
+		float d1 = boxDist2(&box[4 * c1], px, py);
+		if (d0 < d1) {
+			std::swap(c0, c1);
+			std::swap(d0, d1);
+		}
+		stack[top] = c0, stack_d[top++] = d0;
+		stack[top] = c1, stack_d[top++] = d1;
+	}
+	if (found)
+		hit.dist = std::sqrt(best);
+	return found;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+// the point of a curve nearest to a query, at t of segment
+struct CurveHit {
+	int segment{ -1 };
+	float t{ 0.f };
+	float x{ 0.f };
+	float y{ 0.f };
+	float dist{ 0.f };
+};
+
+// bounding volume hierarchy over the cubic Bezier segments of a curve. Consecutive segments lie
+// close together, so the leaves are runs of leaf segments in curve order and the tree over them
+// is complete: built bottom up in O(m), updated along the paths above the changed leaves.
+// A query descends into the closer child first and skips every box farther than the best hit.
+struct CurveBvh {
+	// segments per leaf
+	static constexpr int leaf = 4;
+
+	// m segments, the control points of segment i are cx, cy[4 i..4 i + 3]
+	void build(const float* cx, const float* cy, int m);
+	// the n - 1 segments of the polyline x, y as straight cubics, t runs along each uniformly
+	void buildPolyline(const float* x, const float* y, int n);
+	// segments first..last get the control points cx, cy[4 (i - first)..]
+	void update(int first, int last, const float* cx, const float* cy);
+	void clear();
+
+	int segments() const { return (int)x.size() / 4; }
+	// control points of segment i
+	const float* controlX(int i) const { return &x[4 * i]; }
+	const float* controlY(int i) const { return &y[4 * i]; }
+
+	// the tree for queries of its own, node 0 is the root
+	const float* nodeBox(int k) const { return &box[4 * k]; }
+	bool isLeaf(int k) const { return k >= leaves - 1; }
+	// segments first..last of leaf node k, first > last past the end of the curve
+	void leafSegments(int k, int& first, int& last) const {
+		first = (k - (leaves - 1)) * leaf;
+		last = first + leaf - 1 < segments() - 1 ? first + leaf - 1 : segments() - 1;
+	}
+
+	// the point of the curve nearest to px, py that is closer than max_dist, false if none is.
+	// The segments whose boxes are in reach are projected by Newton's method on the squared
+	// distance, started from the best of a few samples.
+	bool nearest(float px, float py, float max_dist, CurveHit& hit) const;
+
+private:
+	// control points of segment i at 4 i..4 i + 3
+	std::vector<float> x;
+	std::vector<float> y;
+	// min x, min y, max x, max y of every node of a perfect binary tree, the children of node k
+	// are 2 k + 1 and 2 k + 2 and leaf l is node leaves - 1 + l. Leaves past the end of the curve
+	// have empty boxes.
+	std::vector<float> box;
+	int leaves{ 0 };
+
+	// the tree for the segments in x, y
+	void layout();
+	// boxes of the leaves a..b and of every node above them
+	void refit(int a, int b);
+};
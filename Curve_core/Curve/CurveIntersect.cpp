@@ -0,0 +1,215 @@
+#include "CurveIntersect.h"
+
+#include "BezierCurve.h"
+#include "CurveBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// pieces are split at most this often, 1 / 2^24 of a segment is below the precision of t
+constexpr int max_depth = 24;
+// slack of the chord parameters, a crossing on the end of a chord is found by both neighbours
+constexpr float chord_slack = 1e-4f;
+
+// a piece of a segment on t0..t1
+struct Piece {
+	BezierCurve<3> c;
+	float t0;
+	float t1;
+	int depth;
+};
+
+// the piece stays within sqrt(flatness / 16) of its chord
+inline float flatness(const BezierCurve<3>& c) {
+	float ux = 3.f * c.x[1] - 2.f * c.x[0] - c.x[3];
+	float uy = 3.f * c.y[1] - 2.f * c.y[0] - c.y[3];
+	float vx = 3.f * c.x[2] - c.x[0] - 2.f * c.x[3];
+	float vy = 3.f * c.y[2] - c.y[0] - 2.f * c.y[3];
+	return std::max(ux * ux, vx * vx) + std::max(uy * uy, vy * vy);
+}
+
+// min x, min y, max x, max y of the control points, the piece lies inside
+inline void hull(const BezierCurve<3>& c, float* b) {
+	b[0] = b[2] = c.x[0];
+	b[1] = b[3] = c.y[0];
+	for (int i = 1; i < 4; i++) {
+		b[0] = std::min(b[0], c.x[i]), b[2] = std::max(b[2], c.x[i]);
+		b[1] = std::min(b[1], c.y[i]), b[3] = std::max(b[3], c.y[i]);
+	}
+}
+
+// tol, or the rounding of the coordinates around x, y where that is coarser. Far from the origin
+// one crossing found from two sides, or a joint, is not found to within tol.
+inline float slack(float tol, float x, float y) {
+	return std::max(tol, 8.f * std::numeric_limits<float>::epsilon() * std::max(std::fabs(x), std::fabs(y)));
+}
+
+inline bool overlap(const float* a, const float* b) {
+	return a[0] <= b[2] && b[0] <= a[2] && a[1] <= b[3] && b[1] <= a[3];
+}
+
+// the crossings of segment a of one curve and segment b of another, appended to out. The pair of
+// pieces whose hulls overlap is split on the less flat side until both are flat, their chords
+// are crossed then.
+static void crossSegments(const CurveBvh& ca, int a, const CurveBvh& cb, int b, float limit, std::vector<CurveCrossing>& out) {
+	Piece stack[2 * 2 * max_depth + 2][2];
+	int top = 0;
+	stack[top][0] = { {}, 0.f, 1.f, 0 };
+	stack[top][1] = { {}, 0.f, 1.f, 0 };
+	// relative to the start of a, far from the origin the rounding of the coordinates would
+	// exceed limit and no piece would ever be flat
+	float ox = ca.controlX(a)[0], oy = ca.controlY(a)[0];
+	for (int i = 0; i < 4; i++) {
+		stack[top][0].c.x[i] = ca.controlX(a)[i] - ox;
+		stack[top][0].c.y[i] = ca.controlY(a)[i] - oy;
+		stack[top][1].c.x[i] = cb.controlX(b)[i] - ox;
+		stack[top][1].c.y[i] = cb.controlY(b)[i] - oy;
+	}
+	top++;
+	while (top > 0) {
+		top--;
+		Piece p = stack[top][0], q = stack[top][1];
+		float bp[4], bq[4];
+		hull(p.c, bp);
+		hull(q.c, bq);
+		if (!overlap(bp, bq))
+			continue;
+		bool flat_p = p.depth == max_depth || flatness(p.c) <= limit;
+		bool flat_q = q.depth == max_depth || flatness(q.c) <= limit;
+		if (flat_p && flat_q) {
+			float px = p.c.x[3] - p.c.x[0], py = p.c.y[3] - p.c.y[0];
+			float qx = q.c.x[3] - q.c.x[0], qy = q.c.y[3] - q.c.y[0];
+			float den = px * qy - py * qx;
+			// parallel chords of flat pieces run along each other, no single crossing there
+			if (den == 0.f)
+				continue;
+			float wx = q.c.x[0] - p.c.x[0], wy = q.c.y[0] - p.c.y[0];
+			float s = (wx * qy - wy * qx) / den;
+			float u = (wx * py - wy * px) / den;
+			if (!(s >= -chord_slack && s <= 1.f + chord_slack && u >= -chord_slack && u <= 1.f + chord_slack))
+				continue;
+			s = std::clamp(s, 0.f, 1.f);
+			u = std::clamp(u, 0.f, 1.f);
+			out.push_back({ a, p.t0 + s * (p.t1 - p.t0), b, q.t0 + u * (q.t1 - q.t0), ox + p.c.x[0] + s * px, oy + p.c.y[0] + s * py });
+			continue;
+		}
+		// split the piece that is not flat yet, the larger one if neither is
+		bool split_p = !flat_p && (flat_q || (bp[2] - bp[0]) + (bp[3] - bp[1]) >= (bq[2] - bq[0]) + (bq[3] - bq[1]));
+		Piece& s = split_p ? p : q;
+		Piece l, r;
+		s.c.split(0.5f, l.c, r.c);
+		float tm = 0.5f * (s.t0 + s.t1);
+		l.t0 = s.t0, l.t1 = tm, l.depth = s.depth + 1;
+		r.t0 = tm, r.t1 = s.t1, r.depth = s.depth + 1;
+		stack[top][0] = split_p ? l : p;
+		stack[top][1] = split_p ? q : l;
+		top++;
+		stack[top][0] = split_p ? r : p;
+		stack[top][1] = split_p ? q : r;
+		top++;
+	}
+}
+
+// the crossings of the two trees, or of a tree with itself when self. Pairs of nodes whose boxes
+// overlap go down the larger of the two until both are leaves, a node paired with itself goes
+// down into its children paired with themselves and the first with the second, so that segment
+// a comes before segment b.
+static void crossTrees(const CurveBvh& ta, const CurveBvh& tb, float tol, bool self, std::vector<CurveCrossing>& out) {
+	if (ta.segments() == 0 || tb.segments() == 0)
+		return;
+	float limit = 16.f * tol * tol;
+	std::vector<std::pair<int, int>> stack{ { 0, 0 } };
+	while (!stack.empty()) {
+		auto [i, j] = stack.back();
+		stack.pop_back();
+		const float* bi = ta.nodeBox(i);
+		const float* bj = tb.nodeBox(j);
+		if (!overlap(bi, bj))
+			continue;
+		bool leaf_i = ta.isLeaf(i), leaf_j = tb.isLeaf(j);
+		if (leaf_i && leaf_j) {
+			int a0, a1, b0, b1;
+			ta.leafSegments(i, a0, a1);
+			tb.leafSegments(j, b0, b1);
+			for (int a = a0; a <= a1; a++) {
+				BezierCurve<3> c;
+				float ba[4];
+				c.assign(ta.controlX(a), ta.controlY(a));
+				hull(c, ba);
+				// within one leaf every pair once
+				for (int b = self && i == j ? a + 1 : b0; b <= b1; b++) {
+					float bb[4];
+					c.assign(tb.controlX(b), tb.controlY(b));
+					hull(c, bb);
+					if (overlap(ba, bb))
+						crossSegments(ta, a, tb, b, limit, out);
+				}
+			}
+			continue;
+		}
+		if (self && i == j) {
+			stack.push_back({ 2 * i + 1, 2 * i + 1 });
+			stack.push_back({ 2 * i + 1, 2 * i + 2 });
+			stack.push_back({ 2 * i + 2, 2 * i + 2 });
+			continue;
+		}
+		bool down_i = !leaf_i && (leaf_j || (bi[2] - bi[0]) + (bi[3] - bi[1]) >= (bj[2] - bj[0]) + (bj[3] - bj[1]));
+		if (down_i) {
+			stack.push_back({ 2 * i + 1, j });
+			stack.push_back({ 2 * i + 2, j });
+		}
+		else {
+			stack.push_back({ i, 2 * j + 1 });
+			stack.push_back({ i, 2 * j + 2 });
+		}
+	}
+}
+
+// one crossing each, sorted along a. A crossing on the end of a piece or a segment is found from
+// both sides of it, the finds lie within tol (or the rounding there) of each other.
+static void mergeCrossings(std::vector<CurveCrossing>& c, size_t first, float tol) {
+	auto along = [](const CurveCrossing& e) { return e.a + e.ta; };
+	std::sort(c.begin() + first, c.end(), [&](const CurveCrossing& l, const CurveCrossing& r) { return along(l) < along(r); });
+	size_t n = first;
+	for (size_t k = first; k < c.size(); k++) {
+		if (n > first) {
+			const CurveCrossing& p = c[n - 1];
+			float dx = c[k].x - p.x, dy = c[k].y - p.y;
+			float r = slack(tol, p.x, p.y);
+			if (dx * dx + dy * dy <= r * r && along(c[k]) - along(p) <= 1.f && std::fabs(c[k].b + c[k].tb - p.b - p.tb) <= 1.f)
+				continue;
+		}
+		c[n++] = c[k];
+	}
+	c.resize(n);
+}
+
+void IntersectCurves(const CurveBvh& a, const CurveBvh& b, float tol, std::vector<CurveCrossing>& out) {
+	size_t first = out.size();
+	crossTrees(a, b, tol, false, out);
+	mergeCrossings(out, first, tol);
+}
+
+void SelfIntersections(const CurveBvh& a, float tol, std::vector<CurveCrossing>& out) {
+	size_t first = out.size();
+	crossTrees(a, a, tol, true, out);
+	// consecutive segments touch where one ends and the next starts, and so do the ends of a
+	// closed curve, what is found within tol (or the rounding there) of those joints is dropped.
+	int m = a.segments();
+	bool closed = m > 1 && a.controlX(0)[0] == a.controlX(m - 1)[3] && a.controlY(0)[0] == a.controlY(m - 1)[3];
+	auto joint = [&](const CurveCrossing& c) {
+		float jx, jy;
+		if (c.b == c.a + 1)
+			jx = a.controlX(c.b)[0], jy = a.controlY(c.b)[0];
+		else if (closed && c.a == 0 && c.b == m - 1)
+			jx = a.controlX(0)[0], jy = a.controlY(0)[0];
+		else
+			return false;
+		float dx = c.x - jx, dy = c.y - jy;
+		float r = slack(tol, jx, jy);
+		return dx * dx + dy * dy <= r * r;
+	};
+	out.erase(std::remove_if(out.begin() + first, out.end(), joint), out.end());
+	mergeCrossings(out, first, tol);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+struct CurveBvh;
+
+// a point where two curves cross, at ta of segment a of the first and tb of segment b of the second
+struct CurveCrossing {
+	int a;
+	float ta;
+	int b;
+	float tb;
+	float x;
+	float y;
+};
+
+// the crossings of the curves in a and b to within tol, appended to out in the order of a.
+// Both hierarchies are descended at once down to the pairs of segments whose boxes overlap,
+// and those are split in halves until both pieces lie within tol of their chords, which are
+// then crossed as lines. Curves that overlap along a stretch give no crossings there.
+void IntersectCurves(const CurveBvh& a, const CurveBvh& b, float tol, std::vector<CurveCrossing>& out);
+
+// the crossings of the curve in a with itself, with segment a before segment b. Consecutive
+// segments only touching at their shared end point do not cross, nor do the ends of a closed
+// curve. A single segment that loops on itself is not found.
+void SelfIntersections(const CurveBvh& a, float tol, std::vector<CurveCrossing>& out);
@@ -0,0 +1,35 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+void FrameArena::addBlock(size_t size) {
+	blocks.push_back(Block{ std::unique_ptr<char[]>(new char[size]), size });
+	offset = 0;
+}
+
+void* FrameArena::allocBytes(size_t size, size_t align) {
+	if (blocks.empty())
+		addBlock(std::max(block_size, size + align));
+	size_t start = (offset + align - 1) / align * align;
+	if (start + size > blocks.back().size) {
+		addBlock(std::max(block_size, size + align));
+		start = 0;
+	}
+	// new char[] is aligned for every fundamental type
+	offset = start + size;
+	total += size;
+	return blocks.back().data.get() + start;
+}
+
+void FrameArena::reset() {
+	if (blocks.size() > 1) {
+		size_t size = 0;
+		for (const Block& b : blocks)
+			size += b.size;
+		blocks.clear();
+		block_size = std::max(block_size, size);
+		addBlock(block_size);
+	}
+	offset = 0;
+	total = 0;
+}
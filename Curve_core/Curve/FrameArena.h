@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// bump allocator for scratch memory that lives until the next reset. Nothing goes back to the
+// heap, a reset merges the blocks into one that fits everything handed out since the last one,
+// so once the largest frame has been seen a frame does not allocate any more.
+struct FrameArena {
+	explicit FrameArena(size_t block_size = 1 << 16) : block_size(block_size) {}
+
+	// n uninitialized T
+	template<typename T>
+	T* alloc(size_t n) {
+		static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+		return static_cast<T*>(allocBytes(n * sizeof(T), alignof(T)));
+	}
+
+	void reset();
+
+	// bytes handed out since the last reset
+	size_t used() const { return total; }
+
+private:
+	struct Block {
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+	std::vector<Block> blocks;
+	size_t block_size;
+	// into blocks.back()
+	size_t offset{ 0 };
+	size_t total{ 0 };
+
+	void* allocBytes(size_t size, size_t align);
+	void addBlock(size_t size);
+};
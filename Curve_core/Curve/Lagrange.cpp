@@ -0,0 +1,53 @@
+#include "Lagrange.h"
+
+#include <vector>
+
+void LagrangeCurve(const float* t, const float* x, const float* y, int n, int m, float* ox, float* oy) {
+	if (n == 0)
+		return;
+	// a single point, or all of them at one parameter
+	if (n == 1 || t[n - 1] == t[0]) {
+		for (int j = 0; j < m; j++) {
+			ox[j] = x[0];
+			oy[j] = y[0];
+		}
+		return;
+	}
+	// on an interval of length 4 the weights neither over- nor underflow for any sane n
+	double t0 = t[0], scale = 4.0 / ((double)t[n - 1] - t0);
+	std::vector<double> s(n), w(n);
+	for (int i = 0; i < n; i++)
+		s[i] = (t[i] - t0) * scale;
+	for (int i = 0; i < n; i++) {
+		double p = 1.0;
+		for (int k = 0; k < n; k++) {
+			if (k != i)
+				p *= s[i] - s[k];
+		}
+		w[i] = 1.0 / p;
+	}
+	for (int j = 0; j < m; j++) {
+		double u = 4.0 * j / (m - 1);
+		double num_x = 0.0, num_y = 0.0, den = 0.0;
+		int hit = -1;
+		for (int i = 0; i < n; i++) {
+			double d = u - s[i];
+			if (d == 0.0) {
+				hit = i;
+				break;
+			}
+			double c = w[i] / d;
+			num_x += c * x[i];
+			num_y += c * y[i];
+			den += c;
+		}
+		if (hit != -1) {
+			ox[j] = x[hit];
+			oy[j] = y[hit];
+		}
+		else {
+			ox[j] = (float)(num_x / den);
+			oy[j] = (float)(num_y / den);
+		}
+	}
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// m >= 2 samples at uniform t over [t[0], t[n - 1]] of the interpolating polynomial through
+// (t[i], x[i], y[i]) into SoA ox, oy. Barycentric form, O(n^2) once and O(n) per sample.
+void LagrangeCurve(const float* t, const float* x, const float* y, int n, int m, float* ox, float* oy);
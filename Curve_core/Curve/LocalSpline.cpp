@@ -0,0 +1,146 @@
+#include "LocalSpline.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+
+// knots per piece of a parallel loop
+constexpr int grain = 1024;
+
+// a chord over its interval, coincident knots have no velocity
+inline float velocity(float d, float h) {
+	return h > 0.f ? d / h : 0.f;
+}
+
+// slopes of a knot from the velocities va, vb of the chords before and after it, of the
+// intervals ha, hb. Catmull-Rom weighs each chord by the interval of the other, which is the
+// slope of the parabola through the three knots, and Kochanek-Bartels scales the two terms.
+inline Slope kbSlope(float va, float vb, float ha, float hb, const SplineShape& shape) {
+	float wa = ha + hb > 0.f ? hb / (ha + hb) : 0.5f;
+	float t = 1.f - shape.tension;
+	float a = t * (1.f + shape.bias) * wa * va;
+	float b = t * (1.f - shape.bias) * (1.f - wa) * vb;
+	float c = shape.continuity;
+	return { (1.f - c) * a + (1.f + c) * b, (1.f + c) * a + (1.f - c) * b };
+}
+
+// slopes of knot i from the knots on both sides of it, the knot before knot 0 of a closed curve
+// is its last point
+static void knotSlope(SplineCache& s, const SplineShape& shape, int i) {
+	int n = s.segments();
+	int a = i > 0 ? i - 1 : n - 1;
+	float ha = s.h[a], hb = s.h[i];
+	s.kx[i] = kbSlope(velocity(s.x[i] - s.x[a], ha), velocity(s.x[i + 1] - s.x[i], hb), ha, hb, shape);
+	s.ky[i] = kbSlope(velocity(s.y[i] - s.y[a], ha), velocity(s.y[i + 1] - s.y[i], hb), ha, hb, shape);
+	if (i == 0) {
+		s.kx[n] = s.kx[0];
+		s.ky[n] = s.ky[0];
+	}
+}
+
+// the end knot i (0 or the last) of an open curve has no curvature, 4 k0 + 2 k1 = 6 v over the
+// first segment, with the slope of the knot next to it. Tension scales v.
+static void endSlope(SplineCache& s, const SplineShape& shape, int i) {
+	int n = s.segments();
+	float t = 1.f - shape.tension;
+	int a = i == 0 ? 0 : n - 1;
+	float vx = t * velocity(s.x[a + 1] - s.x[a], s.h[a]);
+	float vy = t * velocity(s.y[a + 1] - s.y[a], s.h[a]);
+	float kx = vx, ky = vy;
+	if (n > 1) {
+		kx = (3.f * vx - (i == 0 ? s.kx[1].l : s.kx[n - 1].r)) / 2.f;
+		ky = (3.f * vy - (i == 0 ? s.ky[1].l : s.ky[n - 1].r)) / 2.f;
+	}
+	s.kx[i] = { kx, kx };
+	s.ky[i] = { ky, ky };
+}
+
+// slopes of the knots lo..hi of an open curve, and of the ends that follow the knots next to them
+static void openSlopes(SplineCache& s, const SplineShape& shape, int lo, int hi) {
+	int n = s.segments();
+	int a = std::max(lo, 1), b = std::min(hi, n - 1);
+	ParallelFor(b - a + 1, grain, [&](int begin, int end) {
+		for (int i = a + begin; i < a + end; i++)
+			knotSlope(s, shape, i);
+	});
+	if (lo <= 1)
+		endSlope(s, shape, 0);
+	if (hi >= n - 1)
+		endSlope(s, shape, n);
+}
+
+void LocalSpline(SplineCache& s, int param_type, const SplineShape& shape) {
+	int n = s.segments();
+	if (n == 0)
+		return;
+	Parameterize(s, param_type);
+	// a Hermite spline, the second derivatives are not kept
+	std::fill(s.mx.begin(), s.mx.end(), 0.f);
+	std::fill(s.my.begin(), s.my.end(), 0.f);
+	if (s.periodic()) {
+		ParallelFor(n, grain, [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				knotSlope(s, shape, i);
+		});
+	}
+	else
+		openSlopes(s, shape, 0, n);
+}
+
+int UpdateLocalKnot(SplineCache& s, int param_type, const SplineShape& shape, int k, float x, float y, int* ids) {
+	int n = s.segments();
+	s.x[k] = x;
+	s.y[k] = y;
+	// intervals that see knot k, a Foley interval also weighs the angles at its neighbours
+	int reach = param_type == 3 ? 2 : 1;
+	int h0 = k - reach, h1 = k + reach - 1;
+	if (s.periodic()) {
+		s.x[n] = s.x[0];
+		s.y[n] = s.y[0];
+		// the windows wrap around the seam and hold every segment of a short curve at most once
+		auto wrap = [n](int i) { return (i % n + n) % n; };
+		int m = std::min(h1 - h0 + 1, n);
+		for (int j = 0; j < m; j++) {
+			int i = wrap(h0 + j);
+			// as Parameterize lays them out
+			if (i == 0 || i == n - 1)
+				s.h[i] = ClosedInterval(s.x.data(), s.y.data(), n, param_type, i);
+			else
+				ParamFunc[param_type](s.x.data(), s.y.data(), n + 1, s.h.data(), i, i);
+		}
+		m = std::min(h1 - h0 + 2, n);
+		for (int j = 0; j < m; j++)
+			knotSlope(s, shape, wrap(h0 + j));
+		m = std::min(h1 - h0 + 3, n);
+		for (int j = 0; j < m; j++)
+			ids[j] = wrap(h0 - 1 + j);
+		return m;
+	}
+	h0 = std::max(h0, 0);
+	h1 = std::min(h1, n - 1);
+	ParamFunc[param_type](s.x.data(), s.y.data(), n + 1, s.h.data(), h0, h1);
+	// the knots at both ends of those intervals, and the ends next to them
+	int lo = h0, hi = h1 + 1;
+	openSlopes(s, shape, lo, hi);
+	if (lo <= 1)
+		lo = 0;
+	if (hi >= n - 1)
+		hi = n;
+	int m = 0;
+	for (int i = std::max(lo - 1, 0); i <= std::min(hi, n - 1); i++)
+		ids[m++] = i;
+	return m;
+}
+
+int MoveLocalKnot(SplineCache& s, int param_type, const SplineShape& shape, int k, float x, float y, int* ids) {
+	int m = UpdateLocalKnot(s, param_type, shape, k, x, y, ids);
+	// once per run of consecutive segments, a closed curve may have two
+	for (int j = 0; j < m;) {
+		int e = j;
+		while (e + 1 < m && ids[e + 1] == ids[e] + 1)
+			e++;
+		ResampleSegments(s, ids[j], ids[e]);
+		j = e + 1;
+	}
+	return m;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Spline.h"
+
+// tension, bias and continuity of a Kochanek-Bartels spline, each in [-1, 1]. All zero is the
+// Catmull-Rom spline, tension 1 stops at every knot, bias leans the slope towards the segment
+// before (> 0) or after (< 0) a knot and continuity != 0 gives a knot two slopes.
+struct SplineShape {
+	float tension{ 0.f };
+	float bias{ 0.f };
+	float continuity{ 0.f };
+};
+
+// the Catmull-Rom or Kochanek-Bartels spline through the knots of s, the intervals by
+// param_type: uniform, chordal or centripetal Catmull-Rom (or Foley). The slope of a knot only
+// depends on its two neighbours and the intervals to them, and the ends of an open curve have
+// no curvature. Nothing is solved, sample it afterwards like any other SplineCache.
+void LocalSpline(SplineCache& s, int param_type, const SplineShape& shape);
+
+// knot k of s moves to x, y, the repeated knot of a closed curve follows knot 0. The intervals
+// next to k and the slopes of the knots that see them are set again, nothing is resampled.
+// Writes the segments that changed to ids in curve order and returns how many: four, six for
+// the wider intervals of Foley, fewer at the ends of an open curve.
+int UpdateLocalKnot(SplineCache& s, int param_type, const SplineShape& shape, int k, float x, float y, int* ids);
+// the most segments UpdateLocalKnot changes
+constexpr int max_local_segments = 6;
+
+// UpdateLocalKnot, then the segments that changed are dropped for resampling
+int MoveLocalKnot(SplineCache& s, int param_type, const SplineShape& shape, int k, float x, float y, int* ids);
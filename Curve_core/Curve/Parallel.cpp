@@ -0,0 +1,190 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// set on the workers and on a caller while it runs a job
+thread_local bool in_job = false;
+
+// the pieces lo..hi - 1 left of one share, packed as lo << 32 | hi
+inline uint64_t pack(uint32_t lo, uint32_t hi) { return (uint64_t)lo << 32 | hi; }
+inline uint32_t lo(uint64_t r) { return (uint32_t)(r >> 32); }
+inline uint32_t hi(uint64_t r) { return (uint32_t)r; }
+
+struct Pool {
+	explicit Pool(int workers) : shares(workers + 1) {
+		for (int w = 0; w < workers; w++)
+			threads.emplace_back([this, w] { work(w + 1); });
+	}
+
+	~Pool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (std::thread& t : threads)
+			t.join();
+	}
+
+	int participants() const { return (int)shares.size(); }
+
+	void run(int n, int grain, void (*f)(void*, int, int), void* ctx) {
+		// one job at a time, a second caller waits for the pool
+		std::lock_guard<std::mutex> submit(submit_mutex);
+		int pieces = (n + grain - 1) / grain;
+		int p = participants();
+		for (int i = 0; i < p; i++)
+			shares[i].range.store(pack((uint32_t)((int64_t)pieces * i / p), (uint32_t)((int64_t)pieces * (i + 1) / p)), std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = Job{ n, grain, f, ctx };
+			open = true;
+			++generation;
+		}
+		wake.notify_all();
+
+		in_job = true;
+		participate(0);
+		in_job = false;
+
+		// nothing is left to take, wait for the pieces that are still running
+		std::unique_lock<std::mutex> lock(mutex);
+		open = false;
+		idle.wait(lock, [this] { return active == 0; });
+	}
+
+private:
+	struct Job {
+		int n;
+		int grain;
+		void (*f)(void*, int, int);
+		void* ctx;
+	};
+	// padded so that the shares do not share cache lines
+	struct alignas(64) Share {
+		std::atomic<uint64_t> range{ 0 };
+	};
+
+	std::vector<Share> shares;
+	std::vector<std::thread> threads;
+	std::mutex submit_mutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	Job job{};
+	uint64_t generation{ 0 };
+	int active{ 0 };
+	bool open{ false };
+	bool stop{ false };
+
+	void execute(uint32_t piece) {
+		int begin = (int)piece * job.grain;
+		job.f(job.ctx, begin, std::min(job.n, begin + job.grain));
+	}
+
+	// take the first piece of share p
+	bool pop(int p, uint32_t& piece) {
+		std::atomic<uint64_t>& range = shares[p].range;
+		uint64_t r = range.load(std::memory_order_acquire);
+		while (lo(r) < hi(r)) {
+			if (range.compare_exchange_weak(r, pack(lo(r) + 1, hi(r)), std::memory_order_acq_rel)) {
+				piece = lo(r);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// move the back half of some other share into the empty share p
+	bool steal(int p) {
+		int count = participants();
+		for (int k = 1; k < count; k++) {
+			std::atomic<uint64_t>& victim = shares[(p + k) % count].range;
+			uint64_t r = victim.load(std::memory_order_acquire);
+			while (lo(r) < hi(r)) {
+				uint32_t mid = hi(r) - (hi(r) - lo(r) + 1) / 2;
+				if (victim.compare_exchange_weak(r, pack(lo(r), mid), std::memory_order_acq_rel)) {
+					shares[p].range.store(pack(mid, hi(r)), std::memory_order_release);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void participate(int p) {
+		uint32_t piece;
+		for (;;) {
+			while (pop(p, piece))
+				execute(piece);
+			if (!steal(p))
+				return;
+		}
+	}
+
+	void work(int p) {
+		in_job = true;
+		uint64_t seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stop || generation != seen; });
+				if (stop)
+					return;
+				seen = generation;
+				// the caller already finished this job
+				if (!open)
+					continue;
+				++active;
+			}
+			participate(p);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--active;
+			}
+			idle.notify_one();
+		}
+	}
+};
+
+// one per hardware thread, or CURVE_THREADS of them
+int threadCount() {
+	if (const char* env = std::getenv("CURVE_THREADS")) {
+		int n = std::atoi(env);
+		if (n > 0)
+			return n;
+	}
+	return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+Pool& pool() {
+	static Pool instance(threadCount() - 1);
+	return instance;
+}
+
+}
+
+int ParallelThreads() {
+	return pool().participants();
+}
+
+void ParallelFor(int n, int grain, void (*f)(void* ctx, int begin, int end), void* ctx) {
+	if (n <= 0)
+		return;
+	grain = std::max(grain, 1);
+	if (n <= grain || in_job || pool().participants() == 1) {
+		f(ctx, 0, n);
+		return;
+	}
+	pool().run(n, grain, f, ctx);
+}
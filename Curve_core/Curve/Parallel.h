@@ -0,0 +1,20 @@
+#pragma once
+
+#include <type_traits>
+
+// f(begin, end) over [0, n) in pieces of grain indices, run on the calling thread and a shared
+// pool of workers. Every participant starts on its own share of the pieces and steals half of
+// another share when it runs out. Returns when all pieces are done. Calls from inside a piece,
+// and any n that fits in one piece, run serially on the calling thread.
+void ParallelFor(int n, int grain, void (*f)(void* ctx, int begin, int end), void* ctx);
+
+template<typename F>
+void ParallelFor(int n, int grain, F&& f) {
+	using Fn = std::remove_reference_t<F>;
+	ParallelFor(n, grain, [](void* ctx, int begin, int end) { (*static_cast<Fn*>(ctx))(begin, end); },
+		const_cast<void*>(static_cast<const void*>(&f)));
+}
+
+// threads that take part in a ParallelFor, including the caller. One per hardware thread
+// unless the environment variable CURVE_THREADS gives the number.
+int ParallelThreads();
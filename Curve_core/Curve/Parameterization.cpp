@@ -0,0 +1,238 @@
+#include "Parameterization.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr float pi = 3.14159265358979323846f;
+
+void (*ParamFunc[4])(const float*, const float*, int, float*, int, int) = {
+		UniformParameterize,ChordalParameterize,CentripetalParameterize,FoleyParameterize
+};
+
+inline float distance(const float* x, const float* y, int i, int j) {
+	return std::sqrt((x[j] - x[i]) * (x[j] - x[i]) + (y[j] - y[i]) * (y[j] - y[i]));
+}
+
+void UniformParameterize(const float*, const float*, int, float* h, int first, int last) {
+	for (int i = first; i <= last; i++)
+		h[i] = 1.f;
+}
+
+void ChordalParameterize(const float* x, const float* y, int, float* h, int first, int last) {
+	for (int i = first; i <= last; i++)
+		h[i] = distance(x, y, i, i + 1);
+}
+
+void CentripetalParameterize(const float* x, const float* y, int, float* h, int first, int last) {
+	for (int i = first; i <= last; i++)
+		h[i] = std::sqrt(distance(x, y, i, i + 1));
+}
+
+// min(pi / 2, pi - angle) at knot i
+inline float foleyTheta(const float* x, const float* y, int i) {
+	float bax = x[i - 1] - x[i], bay = y[i - 1] - y[i];
+	float bcx = x[i + 1] - x[i], bcy = y[i + 1] - y[i];
+	float a = std::acos((bax * bcx + bay * bcy) / (std::sqrt(bax * bax + bay * bay) * std::sqrt(bcx * bcx + bcy * bcy)));
+	return std::min(pi / 2.f, pi - a);
+}
+
+// interval of a segment of chord d between chords d0 and d2 with the angles theta0 and theta1
+// at its ends, a missing neighbour has d0 or d2 = 0 and adds nothing
+inline float foleyInterval(float d0, float theta0, float d, float theta1, float d2) {
+	float dt = 1.f;
+	if (d0 > 0.f)
+		dt += 1.5f * d0 * theta0 / (d0 + d);
+	if (d2 > 0.f)
+		dt += 1.5f * d2 * theta1 / (d + d2);
+	return d * dt;
+}
+
+void FoleyParameterize(const float* x, const float* y, int n, float* h, int first, int last) {
+	// at least 3 points
+	if (n < 3) {
+		UniformParameterize(x, y, n, h, first, last);
+		return;
+	}
+	for (int i = first; i <= last; i++) {
+		float d = distance(x, y, i, i + 1);
+		float d0 = i > 0 ? distance(x, y, i - 1, i) : 0.f;
+		float d2 = i < n - 2 ? distance(x, y, i + 1, i + 2) : 0.f;
+		float theta0 = i > 0 ? foleyTheta(x, y, i) : 0.f;
+		float theta1 = i < n - 2 ? foleyTheta(x, y, i + 1) : 0.f;
+		h[i] = foleyInterval(d0, theta0, d, theta1, d2);
+	}
+}
+
+float ClosedInterval(const float* x, const float* y, int n, int param_type, int i) {
+	// the segment in the middle of its four points, laid out as an open curve
+	float wx[4], wy[4];
+	for (int j = 0; j < 4; j++) {
+		wx[j] = x[(i + j - 1 + n) % n];
+		wy[j] = y[(i + j - 1 + n) % n];
+	}
+	float h[3];
+	ParamFunc[param_type](wx, wy, 4, h, 1, 1);
+	return h[1];
+}
+
+void Knots(const float* h, int n, float* t) {
+	if (n == 0)
+		return;
+	t[0] = 0.f;
+	for (int i = 0; i + 1 < n; i++)
+		t[i + 1] = t[i] + h[i];
+}
+
+
+void PrefixSum::push_back(double v) {
+	int i = (int)tree.size();
+	// the new node covers i - lowbit(i + 1) + 1..i, the part before i is a difference of prefixes
+	int lo = i + 1 - ((i + 1) & -(i + 1));
+	tree.push_back(v + prefix(i) - prefix(lo));
+}
+
+void PrefixSum::add(int i, double d) {
+	for (; i < (int)tree.size(); i |= i + 1)
+		tree[i] += d;
+}
+
+double PrefixSum::prefix(int i) const {
+	double s = 0.;
+	for (i--; i >= 0; i = (i & (i + 1)) - 1)
+		s += tree[i];
+	return s;
+}
+
+float Parameterization::interval(int i) const {
+	switch (type) {
+	case 0:
+		return 1.f;
+	case 1:
+		return chord[i];
+	case 2:
+		return std::sqrt(chord[i]);
+	default:
+		if (n < 3)
+			return 1.f;
+		return foleyInterval(i > 0 ? chord[i - 1] : 0.f, theta[i], chord[i],
+			theta[i + 1], i < n - 2 ? chord[i + 1] : 0.f);
+	}
+}
+
+void Parameterization::refresh(const float* x, const float* y, int k) {
+	// the chords and angles that use point k, then the intervals that use those
+	for (int i = std::max(0, k - 1); i <= std::min(n - 2, k); i++)
+		chord[i] = distance(x, y, i, i + 1);
+	if (type == 3) {
+		for (int i = std::max(1, k - 1); i <= std::min(n - 2, k + 1); i++)
+			theta[i] = foleyTheta(x, y, i);
+	}
+	// Foley falls back to uniform below 3 points, so reaching or leaving 3 changes everything
+	int first = std::max(0, k - 2);
+	int last = std::min(n - 2, k + 1);
+	if (type == 3 && n <= 3)
+		first = 0;
+	for (int i = first; i <= last; i++) {
+		float v = interval(i);
+		sum.add(i, (double)v - h[i]);
+		h[i] = v;
+	}
+	t_valid = std::min(t_valid, first + 1);
+	normalized_valid = false;
+}
+
+void Parameterization::assign(const float* x, const float* y, int count, int param_type) {
+	type = param_type;
+	n = count;
+	int m = std::max(n - 1, 0);
+	chord.resize(m);
+	h.resize(m);
+	theta.assign(n, 0.f);
+	for (int i = 0; i < m; i++)
+		chord[i] = distance(x, y, i, i + 1);
+	if (type == 3) {
+		for (int i = 1; i < n - 1; i++)
+			theta[i] = foleyTheta(x, y, i);
+	}
+	sum.clear();
+	for (int i = 0; i < m; i++) {
+		h[i] = interval(i);
+		sum.push_back(h[i]);
+	}
+	t_valid = 0;
+	normalized_valid = false;
+}
+
+void Parameterization::push_back(const float* x, const float* y) {
+	n++;
+	theta.push_back(0.f);
+	if (n > 1) {
+		chord.push_back(0.f);
+		h.push_back(0.f);
+		sum.push_back(0.);
+	}
+	refresh(x, y, n - 1);
+}
+
+void Parameterization::pop_back(const float* x, const float* y) {
+	n--;
+	theta.pop_back();
+	if (n > 0) {
+		chord.pop_back();
+		h.pop_back();
+		sum.pop_back();
+	}
+	t_valid = std::min(t_valid, knots());
+	// the new last point lost its right neighbour
+	if (n > 0)
+		refresh(x, y, n);
+}
+
+void Parameterization::move(const float* x, const float* y, int k) {
+	refresh(x, y, k);
+}
+
+void Parameterization::clear() {
+	n = 0;
+	chord.clear();
+	h.clear();
+	theta.clear();
+	sum.clear();
+	t_valid = 0;
+	normalized_valid = false;
+}
+
+float Parameterization::knot(int i) const {
+	return (float)sum.prefix(i);
+}
+
+float Parameterization::length() const {
+	return (float)sum.prefix(sum.size());
+}
+
+const std::vector<float>& Parameterization::knotVector() {
+	t.resize(knots());
+	if (t_valid < (int)t.size()) {
+		// one prefix query, then a running sum to the end
+		double s = sum.prefix(t_valid);
+		for (int i = t_valid; i < (int)t.size(); i++) {
+			t[i] = (float)s;
+			if (i < (int)h.size())
+				s += h[i];
+		}
+		t_valid = (int)t.size();
+	}
+	return t;
+}
+
+const std::vector<float>& Parameterization::normalizedKnots() {
+	if (!normalized_valid) {
+		const std::vector<float>& k = knotVector();
+		float total = length();
+		normalized.resize(k.size());
+		for (size_t i = 0; i < k.size(); i++)
+			normalized[i] = total > 0.f ? k[i] / total : 0.f;
+		normalized_valid = true;
+	}
+	return normalized;
+}
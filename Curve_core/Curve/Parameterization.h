@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+// four methods to parameterize the knots, writes the interval h[i] = t[i + 1] - t[i]
+// of the segments first..last. The spline does not depend on the scale of t,
+// so the intervals are left unnormalized and an edit only touches its neighbours.
+void UniformParameterize(const float* x, const float* y, int n, float* h, int first, int last);
+void ChordalParameterize(const float* x, const float* y, int n, float* h, int first, int last);
+void CentripetalParameterize(const float* x, const float* y, int n, float* h, int first, int last);
+void FoleyParameterize(const float* x, const float* y, int n, float* h, int first, int last);
+
+// function points for parameterization
+extern void (*ParamFunc[4])(const float*, const float*, int, float*, int, int);
+
+// interval of segment i of a closed curve through n points, from point i to point (i + 1) % n
+// with the neighbours taken across the seam
+float ClosedInterval(const float* x, const float* y, int n, int param_type, int i);
+
+// knots t[0] = 0, t[i + 1] = t[i] + h[i] of n points, h as written by ParamFunc
+void Knots(const float* h, int n, float* t);
+
+// Fenwick tree, prefix sums and point updates in O(log n)
+struct PrefixSum {
+	int size() const { return (int)tree.size(); }
+	void clear() { tree.clear(); }
+	void push_back(double v);
+	void pop_back() { tree.pop_back(); }
+	void add(int i, double d);
+	// sum of the first i values
+	double prefix(int i) const;
+
+private:
+	// tree[i] is the sum of the values i - lowbit(i + 1) + 1..i
+	std::vector<double> tree;
+};
+
+// knots of a point sequence that grows, shrinks at the end and has points moved. Chord
+// lengths and turning angles are kept, so a change only recomputes the few intervals around
+// it and updates their sums in O(log n). Knot vectors are built when they are asked for, and
+// only from the first knot that changed since.
+struct Parameterization {
+	explicit Parameterization(int type = 0) : type(type) {}
+
+	int knots() const { return n; }
+	int param_type() const { return type; }
+
+	// all points of x, y from scratch, in a different method if type changes
+	void assign(const float* x, const float* y, int n, int type);
+	// point n - 1 of x, y was appended
+	void push_back(const float* x, const float* y);
+	void pop_back(const float* x, const float* y);
+	// point k of x, y moved
+	void move(const float* x, const float* y, int k);
+	void clear();
+
+	// t[i] in O(log n), t[0] = 0
+	float knot(int i) const;
+	float length() const;
+	// every t[i], the vector is kept between calls
+	const std::vector<float>& knotVector();
+	// every t[i] / length() in [0, 1]
+	const std::vector<float>& normalizedKnots();
+
+private:
+	int type;
+	int n{ 0 };
+	// per segment
+	std::vector<float> chord;
+	std::vector<float> h;
+	// per knot, the Foley angle, unused at both ends
+	std::vector<float> theta;
+	PrefixSum sum;
+
+	std::vector<float> t;
+	std::vector<float> normalized;
+	// first entry of t that is out of date
+	int t_valid{ 0 };
+	bool normalized_valid{ false };
+
+	// recompute the values that depend on point k, which may lie one past the end after a removal
+	void refresh(const float* x, const float* y, int k);
+	float interval(int i) const;
+};
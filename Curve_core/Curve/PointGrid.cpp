@@ -0,0 +1,110 @@
+#include "PointGrid.h"
+
+#include <cmath>
+
+int PointGrid::bucket(int cx, int cy) const {
+	unsigned h = (unsigned)cx * 73856093u ^ (unsigned)cy * 19349663u;
+	return (int)(h & (unsigned)(head.size() - 1));
+}
+
+int PointGrid::bucketOf(float x, float y) const {
+	return bucket((int)std::floor(x / cell), (int)std::floor(y / cell));
+}
+
+void PointGrid::link(int id) {
+	int b = bucketOf(px[id], py[id]);
+	next[id] = head[b];
+	head[b] = id;
+}
+
+void PointGrid::unlink(int id) {
+	int b = bucketOf(px[id], py[id]);
+	int* p = &head[b];
+	while (*p != id)
+		p = &next[*p];
+	*p = next[id];
+}
+
+void PointGrid::rehash(int buckets) {
+	head.assign(buckets, -1);
+	for (int id = 0; id < (int)used.size(); id++) {
+		if (used[id])
+			link(id);
+	}
+}
+
+void PointGrid::clear() {
+	head.clear();
+	next.clear();
+	px.clear();
+	py.clear();
+	used.clear();
+	size = 0;
+}
+
+void PointGrid::insert(int id, float x, float y) {
+	if (id >= (int)used.size()) {
+		next.resize(id + 1, -1);
+		px.resize(id + 1);
+		py.resize(id + 1);
+		used.resize(id + 1, 0);
+	}
+	if (used[id])
+		erase(id);
+	// keep the load factor at most 1/2
+	if (2 * (size + 1) > (int)head.size())
+		rehash(head.empty() ? 64 : 2 * (int)head.size());
+	px[id] = x;
+	py[id] = y;
+	used[id] = 1;
+	++size;
+	link(id);
+}
+
+void PointGrid::erase(int id) {
+	if (!contains(id))
+		return;
+	unlink(id);
+	used[id] = 0;
+	--size;
+	// ids are dense, trailing free slots can go
+	while (!used.empty() && !used.back()) {
+		used.pop_back();
+		next.pop_back();
+		px.pop_back();
+		py.pop_back();
+	}
+}
+
+void PointGrid::move(int id, float x, float y) {
+	if (!contains(id)) {
+		insert(id, x, y);
+		return;
+	}
+	if (bucketOf(px[id], py[id]) == bucketOf(x, y)) {
+		px[id] = x;
+		py[id] = y;
+		return;
+	}
+	unlink(id);
+	px[id] = x;
+	py[id] = y;
+	link(id);
+}
+
+int PointGrid::find(float x, float y, float r) const {
+	if (size == 0)
+		return -1;
+	int cx0 = (int)std::floor((x - r) / cell), cx1 = (int)std::floor((x + r) / cell);
+	int cy0 = (int)std::floor((y - r) / cell), cy1 = (int)std::floor((y + r) / cell);
+	int ret = -1;
+	for (int cx = cx0; cx <= cx1; cx++) {
+		for (int cy = cy0; cy <= cy1; cy++) {
+			for (int id = head[bucket(cx, cy)]; id != -1; id = next[id]) {
+				if (std::abs(px[id] - x) < r && std::abs(py[id] - y) < r && (ret == -1 || id < ret))
+					ret = id;
+			}
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+// uniform grid over the plane for picking points by dense integer id. Cells are hashed into
+// a power of two bucket table, so the grid needs no bounds and every operation is O(1) expected.
+struct PointGrid {
+	float cell{ 16.f };
+
+	void clear();
+	void insert(int id, float x, float y);
+	void erase(int id);
+	void move(int id, float x, float y);
+	bool contains(int id) const { return id < (int)used.size() && used[id]; }
+
+	// smallest id with |x - px| < r and |y - py| < r, -1 if there is none
+	int find(float x, float y, float r) const;
+
+private:
+	// first id per bucket, -1 if empty
+	std::vector<int> head;
+	// per id, next id in the same bucket
+	std::vector<int> next;
+	std::vector<float> px;
+	std::vector<float> py;
+	std::vector<char> used;
+	int size{ 0 };
+
+	int bucket(int cx, int cy) const;
+	int bucketOf(float x, float y) const;
+	void link(int id);
+	void unlink(int id);
+	void rehash(int buckets);
+};
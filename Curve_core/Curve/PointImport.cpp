@@ -0,0 +1,295 @@
+#include "PointImport.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+PointFormat PointFormatOf(const char* path) {
+	std::string_view p(path);
+	size_t dot = p.find_last_of('.');
+	if (dot == std::string_view::npos)
+		return PointFormat::Csv;
+	std::string_view ext = p.substr(dot + 1);
+	auto is = [&](const char* e) {
+		size_t n = std::strlen(e);
+		if (ext.size() != n)
+			return false;
+		for (size_t i = 0; i < n; i++) {
+			if ((ext[i] | 0x20) != e[i])
+				return false;
+		}
+		return true;
+	};
+	if (is("bin") || is("f32") || is("raw"))
+		return PointFormat::Binary;
+	if (is("svg"))
+		return PointFormat::Svg;
+	return PointFormat::Csv;
+}
+
+bool MappedFile::open(const char* path) {
+	close();
+#if defined(_WIN32)
+	HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (f == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(f, &size)) {
+		CloseHandle(f);
+		return false;
+	}
+	if (size.QuadPart == 0) {
+		CloseHandle(f);
+		return true;
+	}
+	HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(f);
+	if (!m)
+		return false;
+	// the view keeps the mapping open
+	void* p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(m);
+	if (!p)
+		return false;
+	begin = static_cast<const char*>(p);
+	bytes = (size_t)size.QuadPart;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	if (st.st_size == 0) {
+		::close(fd);
+		return true;
+	}
+	void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	// read ahead of the parser
+	madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+	begin = static_cast<const char*>(p);
+	bytes = (size_t)st.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close() {
+	if (!begin)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(begin);
+#else
+	munmap(const_cast<char*>(begin), bytes);
+#endif
+	begin = nullptr;
+	bytes = 0;
+}
+
+namespace {
+
+// gathers the points into chunks for the sink
+struct Chunker {
+	const ImportSink& sink;
+	size_t total;
+	std::vector<float> x;
+	std::vector<float> y;
+	size_t n{ 0 };
+	size_t points{ 0 };
+	bool stopped{ false };
+
+	Chunker(const ImportSink& sink, size_t total, size_t chunk) : sink(sink), total(total), x(chunk), y(chunk) {}
+
+	// false once the sink stopped the import, points that are not finite are left out
+	bool add(float px, float py, const char* at, const char* data) {
+		if (!std::isfinite(px) || !std::isfinite(py))
+			return true;
+		x[n] = px;
+		y[n] = py;
+		if (++n == x.size())
+			flush((size_t)(at - data));
+		return !stopped;
+	}
+
+	void flush(size_t done) {
+		if (n > 0)
+			sink.points(sink.ctx, x.data(), y.data(), n);
+		points += n;
+		n = 0;
+		if (!sink.progress(sink.ctx, done, total))
+			stopped = true;
+	}
+};
+
+inline bool blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// a number at p, from_chars does not take a leading plus
+inline const char* number(const char* p, const char* end, float& v) {
+	if (p < end && *p == '+')
+		p++;
+	auto r = std::from_chars(p, end, v);
+	return r.ec == std::errc() ? r.ptr : nullptr;
+}
+
+void importCsv(const char* data, size_t size, Chunker& out) {
+	const char* end = data + size;
+	for (const char* p = data; p < end;) {
+		const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		if (!eol)
+			eol = end;
+		while (p < eol && blank(*p))
+			p++;
+		float x, y;
+		const char* q = number(p, eol, x);
+		if (q) {
+			const char* s = q;
+			while (s < eol && (blank(*s) || *s == ',' || *s == ';'))
+				s++;
+			if (s > q && number(s, eol, y) && !out.add(x, y, eol, data))
+				return;
+		}
+		p = eol + 1;
+	}
+}
+
+void importBinary(const char* data, size_t size, Chunker& out) {
+	size_t n = size / (2 * sizeof(float));
+	for (size_t i = 0; i < n; i++) {
+		float xy[2];
+		std::memcpy(xy, data + i * sizeof(xy), sizeof(xy));
+		if (!out.add(xy[0], xy[1], data + (i + 1) * sizeof(xy), data))
+			return;
+	}
+}
+
+void importSvg(const char* data, size_t size, Chunker& out) {
+	std::string_view text(data, size);
+	constexpr std::string_view attribute = "points";
+	size_t from = 0;
+	for (size_t at; (at = text.find(attribute, from)) != std::string_view::npos;) {
+		from = at + attribute.size();
+		// the attribute itself, not a word that ends in it
+		if (at == 0 || !(blank(text[at - 1]) || text[at - 1] == '\n'))
+			continue;
+		size_t p = from;
+		while (p < size && (blank(text[p]) || text[p] == '\n'))
+			p++;
+		if (p >= size || text[p] != '=')
+			continue;
+		p++;
+		while (p < size && (blank(text[p]) || text[p] == '\n'))
+			p++;
+		if (p >= size || (text[p] != '"' && text[p] != '\''))
+			continue;
+		size_t close = text.find(text[p], p + 1);
+		if (close == std::string_view::npos)
+			return;
+		// pairs of numbers apart by white space or commas, or by nothing before a sign
+		const char* q = data + p + 1;
+		const char* e = data + close;
+		float v[2];
+		int k = 0;
+		while (q < e) {
+			while (q < e && (blank(*q) || *q == '\n' || *q == ','))
+				q++;
+			if (q == e)
+				break;
+			const char* r = number(q, e, v[k]);
+			if (!r)
+				break;
+			q = r;
+			if (++k == 2) {
+				k = 0;
+				if (!out.add(v[0], v[1], q, data))
+					return;
+			}
+		}
+		from = close + 1;
+	}
+}
+
+} // namespace
+
+size_t ImportPoints(const char* data, size_t size, PointFormat format, const ImportSink& sink, size_t chunk) {
+	// every point takes at least 3 bytes, small inputs get a chunk to fit
+	Chunker out(sink, size, std::max<size_t>(std::min(chunk, size / 3 + 1), 1));
+	if (format == PointFormat::Csv)
+		importCsv(data, size, out);
+	else if (format == PointFormat::Binary)
+		importBinary(data, size, out);
+	else
+		importSvg(data, size, out);
+	if (!out.stopped)
+		out.flush(size);
+	return out.points;
+}
+
+PointImportJob::~PointImportJob() {
+	stop = true;
+	if (thread.joinable())
+		thread.join();
+}
+
+bool PointImportJob::start(const char* path, PointFormat format) {
+	if (!done)
+		return false;
+	if (thread.joinable())
+		thread.join();
+	if (!file.open(path))
+		return false;
+	read_bytes = 0;
+	total_bytes = file.size();
+	stop = false;
+	done = false;
+	thread = std::thread([this, format] {
+		ImportSink sink{ this,
+			[](void* c, const float* x, const float* y, size_t n) {
+				auto job = static_cast<PointImportJob*>(c);
+				std::lock_guard<std::mutex> lock(job->mutex);
+				job->staged_x.insert(job->staged_x.end(), x, x + n);
+				job->staged_y.insert(job->staged_y.end(), y, y + n);
+			},
+			[](void* c, size_t done, size_t) {
+				auto job = static_cast<PointImportJob*>(c);
+				job->read_bytes = done;
+				return !job->stop.load();
+			} };
+		ImportPoints(file.data(), file.size(), format, sink);
+		file.close();
+		done = true;
+	});
+	return true;
+}
+
+size_t PointImportJob::take(std::vector<float>& x, std::vector<float>& y) {
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t n = staged_x.size();
+	x.insert(x.end(), staged_x.begin(), staged_x.end());
+	y.insert(y.end(), staged_y.begin(), staged_y.end());
+	staged_x.clear();
+	staged_y.clear();
+	return n;
+}
+
+float PointImportJob::progress() const {
+	if (done)
+		return 1.f;
+	size_t total = total_bytes;
+	return total > 0 ? (float)read_bytes.load() / (float)total : 0.f;
+}
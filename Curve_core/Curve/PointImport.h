@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// layouts of a file of 2D points:
+//   Csv     one point per line, x and y separated by commas, semicolons or white space. Further
+//           columns are ignored, as are lines that do not start with two numbers (headers, #).
+//   Binary  little-endian float x, y pairs with nothing around them
+//   Svg     the points attributes of the polyline and polygon elements, one after the other
+enum class PointFormat { Csv, Binary, Svg };
+
+// by the extension of path, .bin, .f32 and .raw are Binary, .svg is Svg and the rest Csv
+PointFormat PointFormatOf(const char* path);
+
+// a whole file mapped read-only into memory, the pages are read on first touch
+struct MappedFile {
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	// false if the file cannot be opened or mapped, an empty file maps to no data
+	bool open(const char* path);
+	void close();
+
+	const char* data() const { return begin; }
+	size_t size() const { return bytes; }
+
+private:
+	const char* begin{ nullptr };
+	size_t bytes{ 0 };
+};
+
+// receives the points of an import a chunk at a time, and the bytes read of the total after every
+// chunk. Returning false from progress stops the import.
+struct ImportSink {
+	void* ctx;
+	void (*points)(void* ctx, const float* x, const float* y, size_t n);
+	bool (*progress)(void* ctx, size_t done, size_t total);
+};
+
+// the points of size bytes at data in chunks of up to chunk points, parsed in place without a
+// copy of any line. Returns the number of points, those of a stopped import included.
+size_t ImportPoints(const char* data, size_t size, PointFormat format, const ImportSink& sink, size_t chunk = 1 << 16);
+
+// the same over a mapped file, false if it cannot be mapped
+template<typename Points, typename Progress>
+bool ImportPoints(const char* path, PointFormat format, Points&& points, Progress&& progress) {
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+	struct Ctx {
+		Points& points;
+		Progress& progress;
+	} ctx{ points, progress };
+	ImportSink sink{ &ctx,
+		[](void* c, const float* x, const float* y, size_t n) { static_cast<Ctx*>(c)->points(x, y, n); },
+		[](void* c, size_t done, size_t total) { return (bool)static_cast<Ctx*>(c)->progress(done, total); } };
+	ImportPoints(file.data(), file.size(), format, sink);
+	return true;
+}
+
+// an import on a thread of its own. The points it has read are staged until the owner takes them,
+// so that the owner can add them between its frames and never waits for the file.
+struct PointImportJob {
+	PointImportJob() = default;
+	PointImportJob(const PointImportJob&) = delete;
+	PointImportJob& operator=(const PointImportJob&) = delete;
+	// stops the thread and waits for it
+	~PointImportJob();
+
+	// starts reading path, false if it cannot be mapped or a read is still running
+	bool start(const char* path, PointFormat format);
+	// appends the points staged since the last call to x, y and returns how many
+	size_t take(std::vector<float>& x, std::vector<float>& y);
+	void cancel() { stop = true; }
+
+	// bytes read of the file, 1 once it is through
+	float progress() const;
+	// the thread is through the file or was stopped, points may still be staged
+	bool finished() const { return done; }
+
+private:
+	MappedFile file;
+	std::thread thread;
+	std::mutex mutex;
+	std::vector<float> staged_x;
+	std::vector<float> staged_y;
+	std::atomic<size_t> read_bytes{ 0 };
+	std::atomic<size_t> total_bytes{ 0 };
+	std::atomic<bool> stop{ false };
+	std::atomic<bool> done{ true };
+};
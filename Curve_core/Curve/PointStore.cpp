@@ -0,0 +1,134 @@
+#include "PointStore.h"
+
+#include <algorithm>
+
+void PointStore::reserve(size_t n) {
+	if (n <= capacity())
+		return;
+	x.reserve(n);
+	y.reserve(n);
+	w.reserve(n);
+	t.reserve(n);
+	kx.reserve(n);
+	ky.reserve(n);
+	lx.reserve(n);
+	ly.reserve(n);
+	rx.reserve(n);
+	ry.reserve(n);
+	lratio.reserve(n);
+	rratio.reserve(n);
+	slot.reserve(n);
+}
+
+void PointStore::renumber(int i) {
+	for (int j = i; j < (int)size(); j++)
+		index_of[slot[j]] = j;
+}
+
+void PointStore::insert(int i, float px, float py) {
+	// grow every column at once and geometrically instead of each on its own
+	if (size() == capacity())
+		reserve(std::max<size_t>(16, 2 * capacity()));
+	x.insert(x.begin() + i, px);
+	y.insert(y.begin() + i, py);
+	w.insert(w.begin() + i, 1.f);
+	t.insert(t.begin() + i, 0.f);
+	kx.insert(kx.begin() + i, Slope{ 0.f, 0.f });
+	ky.insert(ky.begin() + i, Slope{ 0.f, 0.f });
+	lx.insert(lx.begin() + i, px);
+	ly.insert(ly.begin() + i, py);
+	rx.insert(rx.begin() + i, px);
+	ry.insert(ry.begin() + i, py);
+	lratio.insert(lratio.begin() + i, 1.f);
+	rratio.insert(rratio.begin() + i, 1.f);
+
+	int s;
+	if (free_slots.empty()) {
+		s = (int)index_of.size();
+		index_of.push_back(-1);
+		gen.push_back(0);
+	}
+	else {
+		s = free_slots.back();
+		free_slots.pop_back();
+	}
+	slot.insert(slot.begin() + i, s);
+	renumber(i);
+}
+
+void PointStore::append(const float* px, const float* py, size_t n) {
+	size_t m = size() + n;
+	if (m > capacity())
+		reserve(std::max(m, 2 * capacity()));
+	x.insert(x.end(), px, px + n);
+	y.insert(y.end(), py, py + n);
+	w.resize(m, 1.f);
+	t.resize(m, 0.f);
+	kx.resize(m, Slope{ 0.f, 0.f });
+	ky.resize(m, Slope{ 0.f, 0.f });
+	lx.insert(lx.end(), px, px + n);
+	ly.insert(ly.end(), py, py + n);
+	rx.insert(rx.end(), px, px + n);
+	ry.insert(ry.end(), py, py + n);
+	lratio.resize(m, 1.f);
+	rratio.resize(m, 1.f);
+
+	int first = (int)slot.size();
+	for (size_t k = 0; k < n; k++) {
+		int s;
+		if (free_slots.empty()) {
+			s = (int)index_of.size();
+			index_of.push_back(-1);
+			gen.push_back(0);
+		}
+		else {
+			s = free_slots.back();
+			free_slots.pop_back();
+		}
+		slot.push_back(s);
+	}
+	renumber(first);
+}
+
+void PointStore::erase(int i) {
+	int s = slot[i];
+	index_of[s] = -1;
+	++gen[s];
+	free_slots.push_back(s);
+
+	x.erase(x.begin() + i);
+	y.erase(y.begin() + i);
+	w.erase(w.begin() + i);
+	t.erase(t.begin() + i);
+	kx.erase(kx.begin() + i);
+	ky.erase(ky.begin() + i);
+	lx.erase(lx.begin() + i);
+	ly.erase(ly.begin() + i);
+	rx.erase(rx.begin() + i);
+	ry.erase(ry.begin() + i);
+	lratio.erase(lratio.begin() + i);
+	rratio.erase(rratio.begin() + i);
+	slot.erase(slot.begin() + i);
+	renumber(i);
+}
+
+void PointStore::clear() {
+	for (int s : slot) {
+		index_of[s] = -1;
+		++gen[s];
+		free_slots.push_back(s);
+	}
+	x.clear();
+	y.clear();
+	w.clear();
+	t.clear();
+	kx.clear();
+	ky.clear();
+	lx.clear();
+	ly.clear();
+	rx.clear();
+	ry.clear();
+	lratio.clear();
+	rratio.clear();
+	slot.clear();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Spline.h"
+
+#include <cstddef>
+#include <vector>
+
+// refers to one point of a PointStore whatever index it moves to, and is invalidated only
+// by removing that point
+struct PointHandle {
+	int slot{ -1 };
+	unsigned gen{ 0 };
+};
+
+// control points of an editable curve, one contiguous column per attribute so that the
+// kernels read x, y or the slopes directly. All columns share one size and grow together.
+struct PointStore {
+	// positions
+	std::vector<float> x;
+	std::vector<float> y;
+	// weight of every point of a NURBS curve, 1 unless edited
+	std::vector<float> w;
+	// parameter of every knot, written by the fit
+	std::vector<float> t;
+	// slopes on both sides
+	std::vector<Slope> kx;
+	std::vector<Slope> ky;
+	// tangent handles, on the left of the point and on the right
+	std::vector<float> lx;
+	std::vector<float> ly;
+	std::vector<float> rx;
+	std::vector<float> ry;
+	// handle length per unit of slope
+	std::vector<float> lratio;
+	std::vector<float> rratio;
+
+	size_t size() const { return x.size(); }
+	bool empty() const { return x.empty(); }
+	size_t capacity() const { return x.capacity(); }
+
+	void reserve(size_t n);
+	// new point at index i with zero slopes, handles on the point and unit ratios
+	void insert(int i, float px, float py);
+	void erase(int i);
+	void push_back(float px, float py) { insert((int)size(), px, py); }
+	// n points at the end as by push_back, every column grows once
+	void append(const float* px, const float* py, size_t n);
+	void pop_back() { erase((int)size() - 1); }
+	void clear();
+
+	PointHandle handle(int i) const { return PointHandle{ slot[i], gen[slot[i]] }; }
+	bool valid(const PointHandle& h) const {
+		return h.slot >= 0 && h.slot < (int)gen.size() && gen[h.slot] == h.gen && index_of[h.slot] >= 0;
+	}
+	// current index of the point, -1 if it was removed
+	int index(const PointHandle& h) const { return valid(h) ? index_of[h.slot] : -1; }
+
+private:
+	// per point, the slot its handles refer to
+	std::vector<int> slot;
+	// per slot, index of the point or -1 if free, and a count of the points it has held
+	std::vector<int> index_of;
+	std::vector<unsigned> gen;
+	std::vector<int> free_slots;
+
+	// index_of for the points from i on after they moved
+	void renumber(int i);
+};
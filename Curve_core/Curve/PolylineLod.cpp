@@ -0,0 +1,251 @@
+#include "PolylineLod.h"
+
+#include "FrameArena.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// significance of the points that are always kept
+constexpr float kept = std::numeric_limits<float>::max();
+// points below which a polyline is simplified on one thread
+constexpr int parallel_min = 1 << 16;
+
+// points a..b still to split, d of the point that split them off
+struct Range {
+	int a;
+	int b;
+	float d;
+};
+
+// split r at the point farthest from the segment between its ends, the ranges on either side
+// go to out, returns how many. A range within floor of its segment is not split, its points
+// all get the distance of the farthest one.
+static int split(const float* x, const float* y, const Range& r, float floor, float* d, Range* out) {
+	if (r.b - r.a < 2)
+		return 0;
+	// squared distances
+	float ax = x[r.a], ay = y[r.a];
+	float dx = x[r.b] - ax, dy = y[r.b] - ay;
+	float len2 = dx * dx + dy * dy;
+	int m = r.a + 1;
+	float best = -1.f;
+	for (int i = r.a + 1; i < r.b; i++) {
+		float px = x[i] - ax, py = y[i] - ay;
+		float t = px * dx + py * dy;
+		float e;
+		if (t <= 0.f || len2 == 0.f)
+			e = px * px + py * py;
+		else if (t >= len2) {
+			float qx = x[i] - x[r.b], qy = y[i] - y[r.b];
+			e = qx * qx + qy * qy;
+		}
+		else {
+			float c = px * dy - py * dx;
+			e = c * c / len2;
+		}
+		if (e > best)
+			best = e, m = i;
+	}
+	// a point is only kept where the range it splits is kept
+	float dm = std::min(std::sqrt(best), r.d);
+	if (dm <= floor) {
+		std::fill(d + r.a + 1, d + r.b, dm);
+		return 0;
+	}
+	d[m] = dm;
+	out[0] = { r.a, m, dm };
+	out[1] = { m, r.b, dm };
+	return 2;
+}
+
+void RdpSignificance(const float* x, const float* y, int n, float* d, FrameArena& arena, float floor) {
+	if (n <= 0)
+		return;
+	d[0] = d[n - 1] = kept;
+	if (n < 3)
+		return;
+	// the open ranges do not overlap, so there are never more than n of them, nor more than
+	// b - a inside of a..b
+	Range* ranges = arena.alloc<Range>(n);
+	Range* next = arena.alloc<Range>(n);
+	int m = 0;
+	ranges[m++] = { 0, n - 1, kept };
+	// long polylines are split breadth first until every thread has a few ranges to finish
+	int enough = ParallelThreads() > 1 && n >= parallel_min ? 4 * ParallelThreads() : 1;
+	while (m > 0 && m < enough) {
+		int k = 0;
+		for (int i = 0; i < m; i++)
+			k += split(x, y, ranges[i], floor, d, next + k);
+		std::swap(ranges, next);
+		m = k;
+	}
+	// next is free, range i is finished depth first on next[a..b]
+	ParallelFor(m, 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			Range* stack = next + ranges[i].a;
+			int top = 0;
+			stack[top++] = ranges[i];
+			while (top > 0) {
+				Range r = stack[--top];
+				top += split(x, y, r, floor, d, stack + top);
+			}
+		}
+	});
+}
+
+int SimplifyPolyline(const float* x, const float* y, int n, float t, float* kx, float* ky, FrameArena& arena) {
+	float* d = arena.alloc<float>(n);
+	RdpSignificance(x, y, n, d, arena, t);
+	int m = 0;
+	for (int i = 0; i < n; i++) {
+		if (d[i] > t) {
+			kx[m] = x[i];
+			ky[m] = y[i];
+			m++;
+		}
+	}
+	return m;
+}
+
+void PolylineLod::addLevel(const float* x, const float* y, const float* d, int n, float t) {
+	level.emplace_back();
+	Level& v = level.back();
+	v.error = std::max(t, 0.f);
+	if (levels() == 1) {
+		v.x.assign(x, x + n);
+		v.y.assign(y, y + n);
+		v.src.resize(n);
+		for (int i = 0; i < n; i++)
+			v.src[i] = i;
+	}
+	else {
+		// a coarser tolerance keeps a subset of the points of the level before
+		const std::vector<int>& src = level[levels() - 2].src;
+		for (int i : src) {
+			if (d[i] > t) {
+				v.x.push_back(x[i]);
+				v.y.push_back(y[i]);
+				v.src.push_back(i);
+			}
+		}
+	}
+	// block c holds the points c block..c block + block, the last one shared with the next block
+	int m = (int)v.x.size();
+	int blocks = (m - 1 + block - 1) / block;
+	v.box.resize(4 * std::max(blocks, 0));
+	for (int c = 0; c < blocks; c++) {
+		int a = c * block, b = std::min(a + block, m - 1);
+		float* box = &v.box[4 * c];
+		box[0] = box[2] = v.x[a];
+		box[1] = box[3] = v.y[a];
+		for (int i = a + 1; i <= b; i++) {
+			box[0] = std::min(box[0], v.x[i]);
+			box[1] = std::min(box[1], v.y[i]);
+			box[2] = std::max(box[2], v.x[i]);
+			box[3] = std::max(box[3], v.y[i]);
+		}
+	}
+}
+
+void PolylineLod::build(const float* x, const float* y, int n, float min_error, FrameArena& arena) {
+	level.clear();
+	if (n <= 0)
+		return;
+	float* d = arena.alloc<float>(n);
+	RdpSignificance(x, y, n, d, arena, min_error);
+	addLevel(x, y, d, n, 0.f);
+	if (n < 3 || !(min_error > 0.f))
+		return;
+
+	// how many points the tolerance min_error 2^k keeps, from the exponents of d / min_error
+	constexpr int max_exponent = 63;
+	int count[max_exponent + 1] = {};
+	for (int i = 0; i < n; i++) {
+		if (d[i] > min_error)
+			count[std::min(std::ilogb(d[i] / min_error), max_exponent)]++;
+	}
+	for (int k = max_exponent - 1; k >= 0; k--)
+		count[k] += count[k + 1];
+	int last = n;
+	for (int k = 0; k < max_exponent && last > 2; k++) {
+		if (count[k] > last / 2)
+			continue;
+		addLevel(x, y, d, n, std::ldexp(min_error, k));
+		last = size(levels() - 1);
+	}
+}
+
+int PolylineLod::pick(float max_error) const {
+	for (int l = levels() - 1; l > 0; l--) {
+		if (level[l].error <= max_error)
+			return l;
+	}
+	return 0;
+}
+
+int PolylineLod::edit(int l, const PolylineEdit* edits, int w, FrameArena& arena, Piece*& pieces) const {
+	const Level& v = level[l];
+	// the polyline before the edits
+	const Level& full = level[0];
+	int m = size(l);
+
+	pieces = arena.alloc<Piece>(2 * w + 1);
+	int k = 0;
+	// the first point of the level that is not drawn yet
+	int next = 0;
+	// the points a..b of the level with the edits e0..e1 between them as one polyline
+	auto patch = [&](int a, int b, int e0, int e1) {
+		if (a > next)
+			pieces[k++] = { next, a, nullptr, nullptr, 0 };
+		int sa = v.src[a], sb = v.src[b];
+		int size = sb - sa + 1;
+		for (int e = e0; e <= e1; e++)
+			size += edits[e].size - (edits[e].last - edits[e].first + 1);
+		float* px = arena.alloc<float>(size);
+		float* py = arena.alloc<float>(size);
+		int o = 0;
+		auto append = [&](const float* x, const float* y, int count) {
+			std::copy(x, x + count, px + o);
+			std::copy(y, y + count, py + o);
+			o += count;
+		};
+		int from = sa;
+		for (int e = e0; e <= e1; e++) {
+			append(full.x.data() + from, full.y.data() + from, edits[e].first - from);
+			append(edits[e].x, edits[e].y, edits[e].size);
+			from = edits[e].last + 1;
+		}
+		append(full.x.data() + from, full.y.data() + from, sb - from + 1);
+		if (v.error == 0.f)
+			pieces[k++] = { a, b, px, py, size };
+		else {
+			float* qx = arena.alloc<float>(size);
+			float* qy = arena.alloc<float>(size);
+			pieces[k++] = { a, b, qx, qy, SimplifyPolyline(px, py, size, v.error, qx, qy, arena) };
+		}
+		next = b;
+	};
+	// the points of the level around an edit, the end points where it reaches the ends. Edits
+	// whose points overlap are one piece.
+	int pa = -1, pb = -1, e0 = 0;
+	for (int e = 0; e < w; e++) {
+		int a = (int)(std::lower_bound(v.src.begin(), v.src.end(), edits[e].first) - v.src.begin()) - 1;
+		int b = (int)(std::upper_bound(v.src.begin(), v.src.end(), edits[e].last) - v.src.begin());
+		a = std::max(a, 0);
+		b = std::min(b, m - 1);
+		if (pb >= 0 && a <= pb) {
+			pb = std::max(pb, b);
+			continue;
+		}
+		if (pb >= 0)
+			patch(pa, pb, e0, e - 1);
+		pa = a, pb = b, e0 = e;
+	}
+	if (pb >= 0)
+		patch(pa, pb, e0, w - 1);
+	if (next < m - 1)
+		pieces[k++] = { next, m - 1, nullptr, nullptr, 0 };
+	return k;
+}
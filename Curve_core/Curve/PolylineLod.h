@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+
+struct FrameArena;
+
+// the points first..last of a polyline replaced by the size points x, y, not necessarily as many
+struct PolylineEdit {
+	int first;
+	int last;
+	const float* x;
+	const float* y;
+	int size;
+};
+
+// Ramer-Douglas-Peucker significance of the n points of the polyline x, y: the simplification
+// to a tolerance t keeps exactly the points with d > t, and every dropped point lies within t
+// of the polyline through the kept ones. The end points are always kept. Significances up to
+// floor are only bounds, the ranges that lie within floor are not split any further.
+// O(n log n) on curves that do not spiral, O(n^2) at worst.
+void RdpSignificance(const float* x, const float* y, int n, float* d, FrameArena& arena, float floor = 0.f);
+
+// the points of x, y kept at tolerance t into kx, ky, returns how many
+int SimplifyPolyline(const float* x, const float* y, int n, float t, float* kx, float* ky, FrameArena& arena);
+
+// level of detail pyramid of a polyline. Level 0 is the polyline itself, every further level its
+// Ramer-Douglas-Peucker simplification to twice the tolerance of the level before, kept only if it
+// has at most half of the points of the last one kept, so the pyramid takes at most twice the
+// memory of the polyline. A view picks the coarsest level that is off by less than a pixel and
+// culls it by blocks, which draws about as many points as the view has pixels along the curve.
+struct PolylineLod {
+	// segments of a level whose bounds are tested together
+	static constexpr int block = 256;
+
+	// the finest simplified level has the tolerance min_error
+	void build(const float* x, const float* y, int n, float min_error, FrameArena& arena);
+	void clear() { level.clear(); }
+
+	int levels() const { return (int)level.size(); }
+	int size(int l) const { return (int)level[l].x.size(); }
+	// how far the polyline may be from level l
+	float error(int l) const { return level[l].error; }
+	// the coarsest level within max_error of the polyline
+	int pick(float max_error) const;
+
+	// f(x, y, m) for the runs of consecutive points of level l whose segments may overlap
+	// [x0, x1] x [y0, y1]
+	template<typename F>
+	void forEachRun(int l, float x0, float y0, float x1, float y1, F&& f) const {
+		levelRuns(l, 0, size(l) - 1, x0, y0, x1, y1, f);
+	}
+
+	// the same with the m edits of the polyline applied, in order and apart from each other. The
+	// level is kept up to its points around the edits, the polyline between those is simplified
+	// again to the error of the level and handed to f as a whole.
+	template<typename F>
+	void forEachRun(int l, float x0, float y0, float x1, float y1, const PolylineEdit* edits, int m,
+		FrameArena& arena, F&& f) const {
+		Piece* pieces;
+		int k = edit(l, edits, m, arena, pieces);
+		for (int i = 0; i < k; i++) {
+			const Piece& p = pieces[i];
+			if (p.x)
+				f(p.x, p.y, p.size);
+			else
+				levelRuns(l, p.a, p.b, x0, y0, x1, y1, f);
+		}
+	}
+
+	// the same after the points first..last of the polyline moved, x, y is the polyline as it is
+	// now. A closed curve may pass a window that wraps around its end, last < first.
+	template<typename F>
+	void forEachRun(int l, float x0, float y0, float x1, float y1, const float* x, const float* y,
+		int first, int last, FrameArena& arena, F&& f) const {
+		PolylineEdit edits[2];
+		int m = 0;
+		if (last < first) {
+			edits[m++] = { 0, last, x, y, last + 1 };
+			last = size(0) - 1;
+		}
+		edits[m++] = { first, last, x + first, y + first, last - first + 1 };
+		forEachRun(l, x0, y0, x1, y1, edits, m, arena, f);
+	}
+
+private:
+	struct Level {
+		float error;
+		std::vector<float> x;
+		std::vector<float> y;
+		// index of every point in the polyline
+		std::vector<int> src;
+		// min x, min y, max x, max y of the points of every block
+		std::vector<float> box;
+	};
+	std::vector<Level> level;
+
+	// points a..b of a level, or the size points of x, y
+	struct Piece {
+		int a;
+		int b;
+		const float* x;
+		const float* y;
+		int size;
+	};
+
+	// the level with the w edits applied as pieces in arena, returns how many
+	int edit(int l, const PolylineEdit* edits, int w, FrameArena& arena, Piece*& pieces) const;
+	void addLevel(const float* x, const float* y, const float* d, int n, float t);
+
+	template<typename F>
+	void levelRuns(int l, int a, int b, float x0, float y0, float x1, float y1, F& f) const {
+		const Level& v = level[l];
+		// the run that is still open, points run_a..run_b
+		int run_a = 0, run_b = -1;
+		for (int c = a / block; c * block < b; c++) {
+			const float* box = &v.box[4 * c];
+			if (box[0] > x1 || box[2] < x0 || box[1] > y1 || box[3] < y0)
+				continue;
+			int ca = c * block > a ? c * block : a;
+			int cb = c * block + block < b ? c * block + block : b;
+			if (ca != run_b) {
+				if (run_b > run_a)
+					f(v.x.data() + run_a, v.y.data() + run_a, run_b - run_a + 1);
+				run_a = ca;
+			}
+			run_b = cb;
+		}
+		if (run_b > run_a)
+			f(v.x.data() + run_a, v.y.data() + run_a, run_b - run_a + 1);
+	}
+};
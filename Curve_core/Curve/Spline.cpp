@@ -0,0 +1,496 @@
+#include "Spline.h"
+
+#include "ArcLength.h"
+#include "Bezier.h"
+#include "FrameArena.h"
+#include "Parallel.h"
+#include "Tridiagonal.h"
+
+#include <algorithm>
+#include <cmath>
+
+// segments per piece of a parallel loop
+constexpr int grain = 1024;
+
+void SplineCache::clear() {
+	x.clear();
+	y.clear();
+	h.clear();
+	mx.clear();
+	my.clear();
+	kx.clear();
+	ky.clear();
+	sx.clear();
+	sy.clear();
+	len.clear();
+	offset.clear();
+	count.clear();
+	box.clear();
+	chunk_box.clear();
+}
+
+void SplineCache::assign(const float* xy, int n) {
+	x.resize(n);
+	y.resize(n);
+	for (int i = 0; i < n; i++) {
+		x[i] = xy[2 * i];
+		y[i] = xy[2 * i + 1];
+	}
+	resetKnots(n);
+}
+
+void SplineCache::assign(const float* px, const float* py, int n) {
+	x.assign(px, px + n);
+	y.assign(py, py + n);
+	resetKnots(n);
+}
+
+void SplineCache::resetKnots(int n) {
+	if (closed && n >= 3) {
+		x.push_back(x[0]);
+		y.push_back(y[0]);
+		n++;
+	}
+	h.resize(std::max(n - 1, 0));
+	mx.assign(n, 0.f);
+	my.assign(n, 0.f);
+	kx.assign(n, Slope{ 0.f, 0.f });
+	ky.assign(n, Slope{ 0.f, 0.f });
+}
+
+void Parameterize(SplineCache& s, int param_type) {
+	int n = s.segments();
+	ParamFunc[param_type](s.x.data(), s.y.data(), s.knots(), s.h.data(), 0, n - 1);
+	// the segments at the seam of a closed curve see the knots across it
+	if (s.periodic()) {
+		s.h[0] = ClosedInterval(s.x.data(), s.y.data(), n, param_type, 0);
+		s.h[n - 1] = ClosedInterval(s.x.data(), s.y.data(), n, param_type, n - 1);
+	}
+}
+
+// slopes at both ends of segment i from the second derivatives
+static void updateSlopes(SplineCache& s, int i) {
+	float h = s.h[i];
+	float dx = (s.x[i + 1] - s.x[i]) / h;
+	float dy = (s.y[i + 1] - s.y[i]) / h;
+	s.kx[i].r = -h * (s.mx[i] * 2.f + s.mx[i + 1]) / 6.f + dx;
+	s.ky[i].r = -h * (s.my[i] * 2.f + s.my[i + 1]) / 6.f + dy;
+	s.kx[i + 1].l = h * (s.mx[i + 1] * 2.f + s.mx[i]) / 6.f + dx;
+	s.ky[i + 1].l = h * (s.my[i + 1] * 2.f + s.my[i]) / 6.f + dy;
+}
+
+// the natural spline is C1, the outer slopes at both ends mirror the inner ones
+static void mirrorEndSlopes(SplineCache& s) {
+	int n = s.segments();
+	s.kx[0].l = s.kx[0].r;
+	s.ky[0].l = s.ky[0].r;
+	s.kx[n].r = s.kx[n].l;
+	s.ky[n].r = s.ky[n].l;
+}
+
+void CubicSpline(SplineCache& s) {
+	FrameArena arena(std::max(s.segments(), 1) * sizeof(float));
+	CubicSpline(s, arena);
+}
+
+// second derivatives at the inner knots into rx, ry, with the system set up and solved in T
+template<typename T>
+static void solveNatural(SplineCache& s, T* rx, T* ry, FrameArena& arena) {
+	int n = s.segments();
+	ParallelFor(n - 1, grain, [&](int begin, int end) {
+		for (int i = begin + 1; i <= end; i++) {
+			T h0 = T(s.h[i - 1]), h1 = T(s.h[i]);
+			rx[i - 1] = T(6) * ((T(s.x[i + 1]) - T(s.x[i])) / h1 - (T(s.x[i]) - T(s.x[i - 1])) / h0);
+			ry[i - 1] = T(6) * ((T(s.y[i + 1]) - T(s.y[i])) / h1 - (T(s.y[i]) - T(s.y[i - 1])) / h0);
+		}
+	});
+	if (s.parallel)
+		SolveSplineRowsParallel(s.h.data(), 1, n - 1, rx, ry, arena);
+	else
+		SolveSplineRows(s.h.data(), 1, n - 1, rx, ry, arena);
+}
+
+// second derivatives at the knots 0..n - 1 of a closed curve, the rows wrap around the seam
+template<typename T>
+static void solvePeriodic(SplineCache& s, T* rx, T* ry, FrameArena& arena) {
+	int n = s.segments();
+	ParallelFor(n, grain, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int p = i > 0 ? i - 1 : n - 1;
+			T h0 = T(s.h[p]), h1 = T(s.h[i]);
+			rx[i] = T(6) * ((T(s.x[i + 1]) - T(s.x[i])) / h1 - (T(s.x[i]) - T(s.x[p])) / h0);
+			ry[i] = T(6) * ((T(s.y[i + 1]) - T(s.y[i])) / h1 - (T(s.y[i]) - T(s.y[p])) / h0);
+		}
+	});
+	SolvePeriodicSplineRows(s.h.data(), n, rx, ry, arena);
+}
+
+template<typename T>
+static void solveSecond(SplineCache& s, T* rx, T* ry, FrameArena& arena) {
+	if (s.periodic())
+		solvePeriodic(s, rx, ry, arena);
+	else
+		solveNatural(s, rx, ry, arena);
+}
+
+void CubicSpline(SplineCache& s, FrameArena& arena) {
+	int n = s.segments();
+	std::fill(s.mx.begin(), s.mx.end(), 0.f);
+	std::fill(s.my.begin(), s.my.end(), 0.f);
+	// unknowns are the inner knots of an open curve and all but the repeated knot of a closed one
+	bool periodic = s.periodic();
+	int first = periodic ? 0 : 1;
+	int m = periodic ? n : n - 1;
+	if (m > 0 && s.precise) {
+		double* rx = arena.alloc<double>(m);
+		double* ry = arena.alloc<double>(m);
+		solveSecond(s, rx, ry, arena);
+		std::copy(rx, rx + m, s.mx.begin() + first);
+		std::copy(ry, ry + m, s.my.begin() + first);
+	}
+	else if (m > 0)
+		solveSecond(s, s.mx.data() + first, s.my.data() + first, arena);
+	if (periodic) {
+		s.mx[n] = s.mx[0];
+		s.my[n] = s.my[0];
+	}
+	// segment i writes the right slopes of knot i and the left ones of knot i + 1
+	ParallelFor(n, grain, [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			updateSlopes(s, i);
+	});
+	// the periodic spline is C1 across the seam
+	if (periodic) {
+		s.kx[0].l = s.kx[n].l;
+		s.ky[0].l = s.ky[n].l;
+		s.kx[n].r = s.kx[0].r;
+		s.ky[n].r = s.ky[0].r;
+	}
+	else if (n > 0)
+		mirrorEndSlopes(s);
+}
+
+void SlopeSpline(SplineCache& s, const Slope* kx, const Slope* ky) {
+	std::fill(s.mx.begin(), s.mx.end(), 0.f);
+	std::fill(s.my.begin(), s.my.end(), 0.f);
+	int n = s.periodic() ? s.knots() - 1 : s.knots();
+	std::copy(kx, kx + n, s.kx.begin());
+	std::copy(ky, ky + n, s.ky.begin());
+	if (s.periodic()) {
+		s.kx[n] = kx[0];
+		s.ky[n] = ky[0];
+	}
+}
+
+void ControlPoints(const SplineCache& s, int i, float* cx, float* cy) {
+	float h = s.h[i] / 3.f;
+	cx[0] = s.x[i];
+	cx[1] = s.x[i] + h * s.kx[i].r;
+	cx[2] = s.x[i + 1] - h * s.kx[i + 1].l;
+	cx[3] = s.x[i + 1];
+	cy[0] = s.y[i];
+	cy[1] = s.y[i] + h * s.ky[i].r;
+	cy[2] = s.y[i + 1] - h * s.ky[i + 1].l;
+	cy[3] = s.y[i + 1];
+}
+
+CubicCoeffs SegmentCoeffs(const SplineCache& s, int i) {
+	float h = s.h[i];
+	//S = h0*y0 + h1*y1 + dy0*H0 + dy1*H1;
+	return HermiteCoeffs(s.x[i], s.x[i + 1], h * s.kx[i].r, h * s.kx[i + 1].l,
+		s.y[i], s.y[i + 1], h * s.ky[i].r, h * s.ky[i + 1].l);
+}
+
+// two quadratures per segment are plenty to share out the samples
+static void updateLengths(SplineCache& s, int first, int last) {
+	ParallelFor(last - first + 1, grain, [&](int begin, int end) {
+		for (int i = first + begin; i < first + end; i++) {
+			CubicCoeffs c = SegmentCoeffs(s, i);
+			s.len[i] = CubicLength(c, 0.f, 0.5f) + CubicLength(c, 0.5f, 1.f);
+		}
+	});
+}
+
+// the curve lies in the convex hull of its control points
+static void updateBounds(SplineCache& s, int first, int last) {
+	ParallelFor(last - first + 1, grain, [&](int begin, int end) {
+		for (int i = first + begin; i < first + end; i++) {
+			float cx[4], cy[4];
+			ControlPoints(s, i, cx, cy);
+			float* b = &s.box[4 * i];
+			b[0] = std::min(std::min(cx[0], cx[1]), std::min(cx[2], cx[3]));
+			b[1] = std::min(std::min(cy[0], cy[1]), std::min(cy[2], cy[3]));
+			b[2] = std::max(std::max(cx[0], cx[1]), std::max(cx[2], cx[3]));
+			b[3] = std::max(std::max(cy[0], cy[1]), std::max(cy[2], cy[3]));
+		}
+	});
+	int n = s.segments();
+	int c0 = first / SplineCache::chunk;
+	int c1 = last / SplineCache::chunk;
+	ParallelFor(c1 - c0 + 1, grain / SplineCache::chunk, [&](int begin, int end) {
+		for (int c = c0 + begin; c < c0 + end; c++) {
+			float* cb = &s.chunk_box[4 * c];
+			const float* b = &s.box[4 * c * SplineCache::chunk];
+			cb[0] = b[0]; cb[1] = b[1]; cb[2] = b[2]; cb[3] = b[3];
+			int last_i = std::min(n, (c + 1) * SplineCache::chunk);
+			for (int i = c * SplineCache::chunk + 1; i < last_i; i++) {
+				b = &s.box[4 * i];
+				cb[0] = std::min(cb[0], b[0]);
+				cb[1] = std::min(cb[1], b[1]);
+				cb[2] = std::max(cb[2], b[2]);
+				cb[3] = std::max(cb[3], b[3]);
+			}
+		}
+	});
+}
+
+// forget all samples, the segments are evaluated on demand
+static void resetSamples(SplineCache& s) {
+	int n = s.segments();
+	s.sx.clear();
+	s.sy.clear();
+	s.offset.assign(n, 0);
+	s.count.assign(n, 0);
+	s.box.resize(4 * n);
+	s.chunk_box.resize(4 * s.chunks());
+	if (n > 0)
+		updateBounds(s, 0, n - 1);
+}
+
+void SampleSpline(SplineCache& s, int sample_num) {
+	int n = s.segments();
+	s.len.resize(n);
+	if (n > 0)
+		updateLengths(s, 0, n - 1);
+	float total = 0.f;
+	for (int i = 0; i < n; i++)
+		total += s.len[i];
+	// all knots in one place, any spacing gives one sample per segment
+	s.step = total > 0.f ? total / (sample_num - 1) : 1.f;
+	s.tol = 0.f;
+	resetSamples(s);
+}
+
+void SampleAdaptive(SplineCache& s, float tol) {
+	s.step = 0.f;
+	s.tol = tol;
+	resetSamples(s);
+}
+
+void ResampleSegments(SplineCache& s, int first, int last) {
+	for (int i = first; i <= last; i++)
+		s.count[i] = 0;
+	if (s.step > 0.f)
+		updateLengths(s, first, last);
+	updateBounds(s, first, last);
+}
+
+void SampleSegment(SplineCache& s, int i) {
+	SampleSegments(s, &i, 1);
+}
+
+void SampleSegments(SplineCache& s, const int* ids, int m) {
+	if (m <= 0)
+		return;
+	// count the samples of every segment, give each its range behind the existing samples,
+	// then fill the ranges. Every segment is evaluated by the same code wherever it runs.
+	ParallelFor(m, grain, [&](int begin, int end) {
+		for (int j = begin; j < end; j++) {
+			int i = ids[j];
+			if (s.step > 0.f)
+				s.count[i] = std::max(1, (int)std::ceil(s.len[i] / s.step));
+			else {
+				float cx[4], cy[4];
+				ControlPoints(s, i, cx, cy);
+				s.count[i] = BezierPieces(cx, cy, s.tol);
+			}
+		}
+	});
+	int size = (int)s.sx.size();
+	for (int j = 0; j < m; j++) {
+		s.offset[ids[j]] = size;
+		size += s.count[ids[j]];
+	}
+	s.sx.resize(size);
+	s.sy.resize(size);
+	ParallelFor(m, grain, [&](int begin, int end) {
+		for (int j = begin; j < end; j++) {
+			int i = ids[j];
+			float* px = s.sx.data() + s.offset[i];
+			float* py = s.sy.data() + s.offset[i];
+			if (s.step > 0.f)
+				EvalCubicUniform(SegmentCoeffs(s, i), s.count[i], px, py);
+			else {
+				float cx[4], cy[4];
+				ControlPoints(s, i, cx, cy);
+				TessellateBezier(cx, cy, s.tol, px, py);
+			}
+		}
+	});
+}
+
+void SampleAll(SplineCache& s) {
+	std::vector<int> ids;
+	for (int i = 0; i < s.segments(); i++) {
+		if (s.count[i] == 0)
+			ids.push_back(i);
+	}
+	SampleSegments(s, ids.data(), (int)ids.size());
+}
+
+// pieces of uniform t that keep a cubic Bezier within tol of its polyline (Wang's formula)
+inline int wangCount(const float* px, const float* py, float tol) {
+	float ax = px[0] - 2.f * px[1] + px[2], ay = py[0] - 2.f * py[1] + py[2];
+	float bx = px[1] - 2.f * px[2] + px[3], by = py[1] - 2.f * py[2] + py[3];
+	float d = std::sqrt(std::max(ax * ax + ay * ay, bx * bx + by * by));
+	return std::clamp((int)std::ceil(std::sqrt(0.75f * d / tol)), 1, 1 << 16);
+}
+
+SegmentPatch SamplePatch(const SplineCache& s, int first, int last, const float* cx, const float* cy, FrameArena& arena) {
+	SegmentPatch patch;
+	patch.first = first;
+	patch.last = last;
+	int m = last - first + 1;
+	int* count = arena.alloc<int>(m);
+	int size = 1;
+	for (int j = 0; j < m; j++) {
+		const float* px = cx + 4 * j;
+		const float* py = cy + 4 * j;
+		if (s.step > 0.f) {
+			CubicCoeffs c = BezierCoeffs(px, py);
+			float len = CubicLength(c, 0.f, 0.5f) + CubicLength(c, 0.5f, 1.f);
+			count[j] = std::max(1, (int)std::ceil(len / s.step));
+		}
+		else
+			count[j] = wangCount(px, py, s.tol);
+		size += count[j];
+	}
+	patch.size = size;
+	patch.x = arena.alloc<float>(size);
+	patch.y = arena.alloc<float>(size);
+	int o = 0;
+	for (int j = 0; j < m; j++) {
+		EvalCubicUniform(BezierCoeffs(cx + 4 * j, cy + 4 * j), count[j], patch.x + o, patch.y + o);
+		o += count[j];
+	}
+	patch.x[o] = cx[4 * m - 1];
+	patch.y[o] = cy[4 * m - 1];
+	return patch;
+}
+
+// how far a change of the second derivative at a knot moves the neighbouring segment of interval h
+inline float deviation(float dmx, float dmy, float h) {
+	return std::max(std::abs(dmx), std::abs(dmy)) * h * h / 8.f;
+}
+
+void MoveKnot(SplineCache& s, int param_type, int k, float x, float y, float tol,
+	FrameArena& arena, int& first, int& last, int& lo, int& hi) {
+	int n = s.segments();
+	s.x[k] = x;
+	s.y[k] = y;
+	// every knot of the cyclic system is coupled across the seam, solve it again in O(n)
+	if (s.periodic()) {
+		s.x[n] = s.x[0];
+		s.y[n] = s.y[0];
+		Parameterize(s, param_type);
+		CubicSpline(s, arena);
+		first = lo = 0;
+		last = n - 1;
+		hi = n;
+		ResampleSegments(s, first, last);
+		return;
+	}
+	// segments whose interval may change
+	int h0 = std::max(0, k - 2);
+	int h1 = std::min(n - 1, k + 1);
+	ParamFunc[param_type](s.x.data(), s.y.data(), n + 1, s.h.data(), h0, h1);
+	first = h0;
+	last = h1;
+	lo = first;
+	hi = last + 1;
+
+	if (n > 1) {
+		// rows of the system whose coefficients or right hand side changed
+		int r0 = std::max(1, std::min(h0, k - 1));
+		int r1 = std::min(n - 1, std::max(h1 + 1, k + 1));
+		float *rx, *ry;
+		int w0, w1;
+		// the change decays geometrically away from the edit, grow the window until it has
+		for (int w = 8;; w *= 2) {
+			w0 = std::max(1, r0 - w);
+			w1 = std::min(n - 1, r1 + w);
+			int m = w1 - w0 + 1;
+			rx = arena.alloc<float>(m);
+			ry = arena.alloc<float>(m);
+			for (int j = 0; j < m; j++) {
+				int i = w0 + j;
+				const float* h = s.h.data();
+				rx[j] = 6.f * ((s.x[i + 1] - s.x[i]) / h[i] - (s.x[i] - s.x[i - 1]) / h[i - 1])
+					- (h[i - 1] * s.mx[i - 1] + 2.f * (h[i - 1] + h[i]) * s.mx[i] + h[i] * s.mx[i + 1]);
+				ry[j] = 6.f * ((s.y[i + 1] - s.y[i]) / h[i] - (s.y[i] - s.y[i - 1]) / h[i - 1])
+					- (h[i - 1] * s.my[i - 1] + 2.f * (h[i - 1] + h[i]) * s.my[i] + h[i] * s.my[i + 1]);
+			}
+			SolveSplineRows(s.h.data(), w0, w1, rx, ry, arena);
+			bool lo_ok = w0 == 1 || deviation(rx[0], ry[0], s.h[w0 - 1]) < tol;
+			bool hi_ok = w1 == n - 1 || deviation(rx[m - 1], ry[m - 1], s.h[w1]) < tol;
+			if (lo_ok && hi_ok)
+				break;
+		}
+		for (int i = w0; i <= w1; i++) {
+			float dmx = rx[i - w0], dmy = ry[i - w0];
+			s.mx[i] += dmx;
+			s.my[i] += dmy;
+			if (deviation(dmx, dmy, std::max(s.h[i - 1], s.h[i])) > tol) {
+				first = std::min(first, i - 1);
+				last = std::max(last, i);
+			}
+		}
+		lo = std::min(lo, w0);
+		hi = std::max(hi, w1);
+	}
+
+	for (int i = first; i <= last; i++)
+		updateSlopes(s, i);
+	// a window that reaches an end moved the inner slope there
+	if (first == 0 || last == n - 1)
+		mirrorEndSlopes(s);
+	ResampleSegments(s, first, last);
+}
+
+void SplineDrag::begin(const float* x, const float* y, int n, int param_type, int sample_num, int k, bool closed) {
+	base.closed = closed;
+	base.assign(x, y, n);
+	Parameterize(base, param_type);
+	CubicSpline(base);
+	SampleSpline(base, sample_num);
+	// work only appends behind the samples of base, which stay valid for every undo
+	SampleAll(base);
+	work = base;
+	index = k;
+	lo = 0;
+	hi = -1;
+	valid = true;
+}
+
+void SplineDrag::move(int param_type, float x, float y, float tol, FrameArena& arena) {
+	// undo the previous move
+	if (lo <= hi) {
+		std::copy(base.x.begin() + lo, base.x.begin() + hi + 1, work.x.begin() + lo);
+		std::copy(base.y.begin() + lo, base.y.begin() + hi + 1, work.y.begin() + lo);
+		std::copy(base.mx.begin() + lo, base.mx.begin() + hi + 1, work.mx.begin() + lo);
+		std::copy(base.my.begin() + lo, base.my.begin() + hi + 1, work.my.begin() + lo);
+		std::copy(base.kx.begin() + lo, base.kx.begin() + hi + 1, work.kx.begin() + lo);
+		std::copy(base.ky.begin() + lo, base.ky.begin() + hi + 1, work.ky.begin() + lo);
+		std::copy(base.h.begin() + lo, base.h.begin() + hi, work.h.begin() + lo);
+		std::copy(base.len.begin() + lo, base.len.begin() + hi, work.len.begin() + lo);
+		std::copy(base.offset.begin() + lo, base.offset.begin() + hi, work.offset.begin() + lo);
+		std::copy(base.count.begin() + lo, base.count.begin() + hi, work.count.begin() + lo);
+		std::copy(base.box.begin() + 4 * lo, base.box.begin() + 4 * hi, work.box.begin() + 4 * lo);
+		for (int c = lo / SplineCache::chunk; c <= (hi - 1) / SplineCache::chunk; c++)
+			std::copy(base.chunk_box.begin() + 4 * c, base.chunk_box.begin() + 4 * c + 4, work.chunk_box.begin() + 4 * c);
+		work.sx.resize(base.sx.size());
+		work.sy.resize(base.sy.size());
+	}
+	int first, last;
+	MoveKnot(work, param_type, index, x, y, tol, arena, first, last, lo, hi);
+}
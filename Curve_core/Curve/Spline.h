@@ -0,0 +1,165 @@
+#pragma once
+
+#include "CubicEval.h"
+#include "Parameterization.h"
+
+#include <vector>
+
+struct FrameArena;
+
+// slopes on the left and right side of a knot
+struct Slope {
+	float l;
+	float r;
+};
+
+// piecewise cubic Hermite curve through 2D knots, kept per segment so that an edit can be
+// re-solved and re-sampled locally and off-screen segments are never evaluated
+struct SplineCache {
+	// segments per chunk of the coarse culling level
+	static constexpr int chunk = 64;
+
+	// knots
+	std::vector<float> x;
+	std::vector<float> y;
+	// parameter interval of each segment
+	std::vector<float> h;
+	// second derivatives, zero at both ends of the natural spline
+	std::vector<float> mx;
+	std::vector<float> my;
+	// slopes at the knots, segment i uses kx[i].r and kx[i + 1].l
+	std::vector<Slope> kx;
+	std::vector<Slope> ky;
+	// arc length of each segment, kept while sampling uniformly
+	std::vector<float> len;
+
+	// samples on [0, 1) of segment i are [offset[i], offset[i] + count[i]) of sx, sy,
+	// the knot i + 1 closes the segment and count[i] == 0 means not evaluated yet
+	std::vector<float> sx;
+	std::vector<float> sy;
+	std::vector<int> offset;
+	std::vector<int> count;
+	// arc length spacing of the samples, uniform in t inside a segment, or 0 to tessellate adaptively to tol
+	float step{ 0.f };
+	float tol{ 0.f };
+	// set up and solve the natural spline system in double, floats drift on long chains
+	bool precise{ false };
+	// solve the natural spline system in parallel blocks, faster for long curves on several
+	// cores. The result does not depend on the number of threads, but differs from the serial
+	// solve in the last bits.
+	bool parallel{ false };
+	// a closed curve repeats its first knot behind the last one, so that the last segment runs
+	// back to it, and is solved as a periodic spline. Set before assign, fewer than 3 points stay open.
+	bool closed{ false };
+
+	// min x, min y, max x, max y of the control polygon per segment and per chunk
+	std::vector<float> box;
+	std::vector<float> chunk_box;
+
+	int knots() const { return (int)x.size(); }
+	int segments() const { return x.empty() ? 0 : (int)x.size() - 1; }
+	int chunks() const { return (segments() + chunk - 1) / chunk; }
+	bool periodic() const { return closed && x.size() > 3; }
+
+	void clear();
+	// knots from interleaved (x, y) pairs
+	void assign(const float* xy, int n);
+	// knots from separate x and y columns
+	void assign(const float* x, const float* y, int n);
+
+private:
+	// intervals and slopes of n knots, after closing the curve
+	void resetKnots(int n);
+};
+
+// interval of every segment
+void Parameterize(SplineCache& s, int param_type);
+
+// second derivatives and slopes of the natural or, for a closed curve, the periodic spline
+void CubicSpline(SplineCache& s);
+void CubicSpline(SplineCache& s, FrameArena& arena);
+
+// Hermite spline through the knots with the given slopes, nothing is solved. A closed curve
+// takes one slope per point and reuses the first at its repeated knot.
+void SlopeSpline(SplineCache& s, const Slope* kx, const Slope* ky);
+
+// control points of segment i as Bezier, x0..x3 and y0..y3
+void ControlPoints(const SplineCache& s, int i, float* cx, float* cy);
+
+// power basis of segment i on t in [0, 1]
+CubicCoeffs SegmentCoeffs(const SplineCache& s, int i);
+
+// sample about sample_num samples over the whole curve, every segment gets a share of them
+// by its arc length so that the density does not depend on the parameterization
+void SampleSpline(SplineCache& s, int sample_num);
+
+// sample every segment until it lies within tol of its polyline
+void SampleAdaptive(SplineCache& s, float tol);
+
+// drop the samples of segments first..last and update their bounds, they are evaluated on demand
+void ResampleSegments(SplineCache& s, int first, int last);
+
+// evaluate segment i, its samples are appended to sx, sy
+void SampleSegment(SplineCache& s, int i);
+
+// evaluate the m distinct segments ids that have no samples, in parallel for many of them.
+// The samples are laid out in the order of ids, exactly as SampleSegment one id after the
+// other would lay them out.
+void SampleSegments(SplineCache& s, const int* ids, int m);
+// evaluate every segment that has no samples
+void SampleAll(SplineCache& s);
+
+// one polyline from the start of segment first to the end of segment last that stands in for
+// those segments of a curve, e.g. for a preview that changes a single knot
+struct SegmentPatch {
+	int first{ 0 };
+	int last{ -1 };
+	int size{ 0 };
+	float* x{ nullptr };
+	float* y{ nullptr };
+};
+
+// sample the Bezier segments with control points cx, cy[4 j..4 j + 3] that replace segments
+// first..last of s, as densely as s samples its own segments, the points live in arena
+SegmentPatch SamplePatch(const SplineCache& s, int first, int last, const float* cx, const float* cy, FrameArena& arena);
+
+// f(i) for every segment whose bounds overlap [x0, x1] x [y0, y1]
+template<typename F>
+void ForEachVisible(const SplineCache& s, float x0, float y0, float x1, float y1, F&& f) {
+	auto overlap = [&](const float* b) {
+		return b[0] <= x1 && b[2] >= x0 && b[1] <= y1 && b[3] >= y0;
+	};
+	int n = s.segments();
+	for (int c = 0; c < s.chunks(); c++) {
+		if (!overlap(&s.chunk_box[4 * c]))
+			continue;
+		int end = c * SplineCache::chunk + SplineCache::chunk < n ? c * SplineCache::chunk + SplineCache::chunk : n;
+		for (int i = c * SplineCache::chunk; i < end; i++) {
+			if (overlap(&s.box[4 * i]))
+				f(i);
+		}
+	}
+}
+
+// move knot k of a solved natural spline and re-solve only the window whose second derivatives
+// change enough to move the curve by more than tol, first..last gets the resampled segments and
+// lo..hi the knots that differ from before. k is a point, the repeated knot of a closed curve
+// follows knot 0, and a closed curve is solved again as a whole.
+void MoveKnot(SplineCache& s, int param_type, int k, float x, float y, float tol,
+	FrameArena& arena, int& first, int& last, int& lo, int& hi);
+
+// dragging one knot of a natural spline, every move is applied on top of an untouched base
+// so that the local solves never accumulate error
+struct SplineDrag {
+	SplineCache base;
+	SplineCache work;
+	int index{ -1 };
+	// knots of work that differ from base
+	int lo{ 0 };
+	int hi{ -1 };
+	bool valid{ false };
+
+	void begin(const float* x, const float* y, int n, int param_type, int sample_num, int k, bool closed = false);
+	void move(int param_type, float x, float y, float tol, FrameArena& arena);
+	void invalidate() { valid = false; }
+};
@@ -0,0 +1,332 @@
+#include "Subdivision.h"
+
+#include "CubicEval.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+// the widest kernel the compiler is allowed to emit, as in CubicEval
+#if defined(__AVX2__) && defined(__FMA__) || defined(_MSC_VER) && defined(__AVX2__)
+#include <immintrin.h>
+#define SUBDIVISION_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86_FP) && _M_IX86_FP >= 2
+#include <emmintrin.h>
+#define SUBDIVISION_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SUBDIVISION_NEON
+#endif
+
+// edges per piece of a parallel pass
+constexpr int grain = 4096;
+
+// weights of the children 2 i and 2 i + 1 of edge i on the points i - 1..i + 2
+struct Stencil {
+	float even[4];
+	float odd[4];
+};
+
+constexpr Stencil stencils[subdivision_schemes] = {
+	{ { 0.f, 0.75f, 0.25f, 0.f }, { 0.f, 0.25f, 0.75f, 0.f } },
+	{ { 0.125f, 0.75f, 0.125f, 0.f }, { 0.f, 0.5f, 0.5f, 0.f } },
+	{ { 0.f, 1.f, 0.f, 0.f }, { -0.0625f, 0.5625f, 0.5625f, -0.0625f } },
+};
+
+// one child in the order of operations of the vector kernel, so that a point comes out the
+// same whether a full pass or the window of a move computes it
+inline float weigh(const float* w, const float* p) {
+#if defined(SUBDIVISION_AVX2)
+	return std::fma(w[3], p[2], std::fma(w[2], p[1], std::fma(w[1], p[0], w[0] * p[-1])));
+#elif defined(SUBDIVISION_SSE2)
+	return (w[0] * p[-1] + w[1] * p[0]) + (w[2] * p[1] + w[3] * p[2]);
+#else
+	return ((w[0] * p[-1] + w[1] * p[0]) + w[2] * p[1]) + w[3] * p[2];
+#endif
+}
+
+// children of the m edges starting at p into q[0..2 m - 1], reads p[-1..m + 1]
+static void applyStencil(const Stencil& s, const float* p, int m, float* q) {
+	int i = 0;
+#if defined(SUBDIVISION_AVX2)
+	__m256 e0 = _mm256_set1_ps(s.even[0]), e1 = _mm256_set1_ps(s.even[1]);
+	__m256 e2 = _mm256_set1_ps(s.even[2]), e3 = _mm256_set1_ps(s.even[3]);
+	__m256 o0 = _mm256_set1_ps(s.odd[0]), o1 = _mm256_set1_ps(s.odd[1]);
+	__m256 o2 = _mm256_set1_ps(s.odd[2]), o3 = _mm256_set1_ps(s.odd[3]);
+	for (; i + 8 <= m; i += 8) {
+		__m256 a = _mm256_loadu_ps(p + i - 1), b = _mm256_loadu_ps(p + i);
+		__m256 c = _mm256_loadu_ps(p + i + 1), d = _mm256_loadu_ps(p + i + 2);
+		__m256 e = _mm256_fmadd_ps(e3, d, _mm256_fmadd_ps(e2, c, _mm256_fmadd_ps(e1, b, _mm256_mul_ps(e0, a))));
+		__m256 o = _mm256_fmadd_ps(o3, d, _mm256_fmadd_ps(o2, c, _mm256_fmadd_ps(o1, b, _mm256_mul_ps(o0, a))));
+		// interleaved within the 128 bit lanes, then the lanes put in order
+		__m256 lo = _mm256_unpacklo_ps(e, o), hi = _mm256_unpackhi_ps(e, o);
+		_mm256_storeu_ps(q + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(q + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+#elif defined(SUBDIVISION_SSE2)
+	__m128 e0 = _mm_set1_ps(s.even[0]), e1 = _mm_set1_ps(s.even[1]);
+	__m128 e2 = _mm_set1_ps(s.even[2]), e3 = _mm_set1_ps(s.even[3]);
+	__m128 o0 = _mm_set1_ps(s.odd[0]), o1 = _mm_set1_ps(s.odd[1]);
+	__m128 o2 = _mm_set1_ps(s.odd[2]), o3 = _mm_set1_ps(s.odd[3]);
+	for (; i + 4 <= m; i += 4) {
+		__m128 a = _mm_loadu_ps(p + i - 1), b = _mm_loadu_ps(p + i);
+		__m128 c = _mm_loadu_ps(p + i + 1), d = _mm_loadu_ps(p + i + 2);
+		__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e0, a), _mm_mul_ps(e1, b)), _mm_add_ps(_mm_mul_ps(e2, c), _mm_mul_ps(e3, d)));
+		__m128 o = _mm_add_ps(_mm_add_ps(_mm_mul_ps(o0, a), _mm_mul_ps(o1, b)), _mm_add_ps(_mm_mul_ps(o2, c), _mm_mul_ps(o3, d)));
+		_mm_storeu_ps(q + 2 * i, _mm_unpacklo_ps(e, o));
+		_mm_storeu_ps(q + 2 * i + 4, _mm_unpackhi_ps(e, o));
+	}
+#elif defined(SUBDIVISION_NEON)
+	for (; i + 4 <= m; i += 4) {
+		float32x4_t a = vld1q_f32(p + i - 1), b = vld1q_f32(p + i);
+		float32x4_t c = vld1q_f32(p + i + 1), d = vld1q_f32(p + i + 2);
+		float32x4x2_t eo;
+		eo.val[0] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(a, s.even[0]), b, s.even[1]), c, s.even[2]), d, s.even[3]);
+		eo.val[1] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(a, s.odd[0]), b, s.odd[1]), c, s.odd[2]), d, s.odd[3]);
+		// the store interleaves
+		vst2q_f32(q + 2 * i, eo);
+	}
+#endif
+	for (; i < m; i++) {
+		q[2 * i] = weigh(s.even, p + i);
+		q[2 * i + 1] = weigh(s.odd, p + i);
+	}
+}
+
+int SubdivisionSize(int scheme, bool closed, int n) {
+	return closed || scheme == 0 ? 2 * n : 2 * n - 1;
+}
+
+// smaller polygons are left as they are
+inline int minPoints(bool closed) {
+	return closed ? 3 : 2;
+}
+
+inline int mod(int i, int n) {
+	return (i % n + n) % n;
+}
+
+void Subdivision::layout() {
+	offset.resize(count.size());
+	int o = ghost;
+	for (size_t l = 0; l < count.size(); l++) {
+		offset[l] = o;
+		o += count[l] + 2 * ghost;
+	}
+	if ((int)bx.size() < o - ghost) {
+		bx.resize(o - ghost);
+		by.resize(o - ghost);
+	}
+}
+
+void Subdivision::fillGhosts(int l) {
+	int n = count[l];
+	if (n < minPoints(closed))
+		return;
+	auto fill = [&](float* p) {
+		if (closed) {
+			p[-2] = p[n - 2];
+			p[-1] = p[n - 1];
+			p[n] = p[0];
+			p[n + 1] = p[1];
+		}
+		else if (scheme == 0) {
+			p[-2] = p[-1] = p[0];
+			p[n] = p[n + 1] = p[n - 1];
+		}
+		else {
+			p[-2] = p[-1] = 2.f * p[0] - p[1];
+			p[n] = p[n + 1] = 2.f * p[n - 1] - p[n - 2];
+		}
+	};
+	fill(bx.data() + offset[l]);
+	fill(by.data() + offset[l]);
+}
+
+void Subdivision::load(const float* x, const float* y, int n) {
+	std::copy(x, x + n, bx.begin() + offset[0]);
+	std::copy(y, y + n, by.begin() + offset[0]);
+	fillGhosts(0);
+}
+
+// open Chaikin also cuts the edges to the doubled end points, edge -1 included, and the first
+// child of that edge is dropped, so the children of edge i start at 2 i + 1
+inline int firstEdge(int scheme, bool closed) {
+	return !closed && scheme == 0 ? -1 : 0;
+}
+
+void Subdivision::pass(int l, int a, int b) {
+	const Stencil& s = stencils[scheme];
+	int shift = -firstEdge(scheme, closed);
+	const float* px = bx.data() + offset[l];
+	const float* py = by.data() + offset[l];
+	float* qx = bx.data() + offset[l + 1] + shift;
+	float* qy = by.data() + offset[l + 1] + shift;
+	ParallelFor(b - a + 1, grain, [&](int begin, int end) {
+		int i = a + begin;
+		applyStencil(s, px + i, end - begin, qx + 2 * i);
+		applyStencil(s, py + i, end - begin, qy + 2 * i);
+	});
+}
+
+void Subdivision::refine(const float* x, const float* y, int n, int levels) {
+	if (n < minPoints(closed))
+		levels = 0;
+	count.resize(levels + 1);
+	count[0] = n;
+	for (int l = 0; l < levels; l++)
+		count[l + 1] = SubdivisionSize(scheme, closed, count[l]);
+	spans = false;
+	layout();
+	load(x, y, n);
+	for (int l = 0; l < levels; l++) {
+		pass(l, firstEdge(scheme, closed), count[l] - 1);
+		fillGhosts(l + 1);
+	}
+}
+
+// span of the quadratic B-spline on p[-1..1], from the middle of p[-1], p[0] to that of p[0], p[1]
+inline void quadraticSpan(const float* p, float& a, float& b, float& c, float& d) {
+	a = 0.5f * (p[-1] + p[0]);
+	b = p[0] - p[-1];
+	c = 0.5f * (p[-1] - 2.f * p[0] + p[1]);
+	d = 0.f;
+}
+
+// span of the uniform cubic B-spline on p[-1..2], from the limit of p[0] to that of p[1]
+inline void cubicSpan(const float* p, float& a, float& b, float& c, float& d) {
+	a = (p[-1] + 4.f * p[0] + p[1]) / 6.f;
+	b = 0.5f * (p[1] - p[-1]);
+	c = 0.5f * (p[-1] - 2.f * p[0] + p[1]);
+	d = (3.f * (p[0] - p[1]) + p[2] - p[-1]) / 6.f;
+}
+
+// spans of the limit curve of n points, Chaikin has one around every point and the cubic
+// B-spline one between every two
+inline int spanCount(int scheme, bool closed, int n) {
+	return closed || scheme == 0 ? n : n - 1;
+}
+
+void Subdivision::evalSpans(int a, int b) {
+	const float* px = bx.data() + offset[0];
+	const float* py = by.data() + offset[0];
+	float* qx = bx.data() + offset[1];
+	float* qy = by.data() + offset[1];
+	ParallelFor(b - a + 1, std::max(1, grain / per_span), [&](int begin, int end) {
+		for (int j = a + begin; j < a + end; j++) {
+			CubicCoeffs c;
+			if (scheme == 0) {
+				quadraticSpan(px + j, c.ax, c.bx, c.cx, c.dx);
+				quadraticSpan(py + j, c.ay, c.by, c.cy, c.dy);
+			}
+			else {
+				cubicSpan(px + j, c.ax, c.bx, c.cx, c.dx);
+				cubicSpan(py + j, c.ay, c.by, c.cy, c.dy);
+			}
+			EvalCubicUniform(c, per_span, qx + j * per_span, qy + j * per_span);
+		}
+	});
+	// both open limit curves end in the last point
+	int n = count[0];
+	if (!closed && b == spanCount(scheme, closed, n) - 1) {
+		qx[count[1] - 1] = px[n - 1];
+		qy[count[1] - 1] = py[n - 1];
+	}
+}
+
+void Subdivision::limit(const float* x, const float* y, int n, int levels) {
+	if (scheme == 2 || n < minPoints(closed)) {
+		refine(x, y, n, levels);
+		return;
+	}
+	per_span = 1 << levels;
+	int m = spanCount(scheme, closed, n);
+	count = { n, m * per_span + (closed ? 0 : 1) };
+	spans = true;
+	layout();
+	load(x, y, n);
+	evalSpans(0, m - 1);
+}
+
+void Subdivision::move(int k, float px, float py, int& first, int& last) {
+	bx[offset[0] + k] = px;
+	by[offset[0] + k] = py;
+	fillGhosts(0);
+	int n = count[0];
+	if (n < minPoints(closed)) {
+		first = last = k;
+		return;
+	}
+
+	if (spans) {
+		// the spans that read point k
+		int m = spanCount(scheme, closed, n);
+		int a = k - (scheme == 0 ? 1 : 2), b = k + 1;
+		if (closed && b - a + 1 < m) {
+			int w = b - a;
+			a = mod(a, m);
+			b = a + w;
+			if (b < m)
+				evalSpans(a, b);
+			else {
+				evalSpans(a, m - 1);
+				evalSpans(0, b - m);
+			}
+			first = a * per_span;
+			last = mod((b + 1) * per_span - 1, count[1]);
+			return;
+		}
+		a = closed ? 0 : std::max(a, 0);
+		b = closed ? m - 1 : std::min(b, m - 1);
+		evalSpans(a, b);
+		first = a * per_span;
+		// the end point of an open curve comes with the last span
+		last = b == m - 1 ? count[1] - 1 : (b + 1) * per_span - 1;
+		return;
+	}
+
+	// lo..hi changed on level l, on a closed curve taken mod the size of the level
+	int lo = k, hi = k;
+	int shift = -firstEdge(scheme, closed);
+	for (int l = 0; l + 1 < (int)count.size(); l++) {
+		int m = count[l];
+		// edge i reads the points i - 1..i + 2
+		int a = lo - 2, b = hi + 1;
+		if (closed) {
+			if (b - a + 1 >= m) {
+				a = 0;
+				b = m - 1;
+				pass(l, a, b);
+			}
+			else {
+				a = mod(a, m);
+				b = a + (hi - lo) + 3;
+				if (b < m)
+					pass(l, a, b);
+				else {
+					pass(l, a, m - 1);
+					pass(l, 0, b - m);
+				}
+			}
+			lo = 2 * a;
+			hi = 2 * b + 1;
+		}
+		else {
+			a = std::max(a, -shift);
+			b = std::min(b, m - 1);
+			pass(l, a, b);
+			lo = std::max(0, 2 * a + shift);
+			hi = std::min(count[l + 1] - 1, 2 * b + 1 + shift);
+		}
+		fillGhosts(l + 1);
+	}
+	int m = count.back();
+	if (closed && hi - lo + 1 >= m) {
+		first = 0;
+		last = m - 1;
+	}
+	else {
+		first = closed ? mod(lo, m) : lo;
+		last = closed ? mod(hi, m) : hi;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+// subdivision schemes of a control polygon
+//   0 Chaikin corner cutting, converges to the quadratic B-spline of the polygon
+//   1 cubic B-spline, converges to the uniform cubic B-spline of the polygon
+//   2 4-point (Dyn, Levin and Gregory with w = 1 / 16), interpolates the polygon
+// Open polygons keep their end points, Chaikin doubles them and the other two mirror the
+// neighbour of an end point across it.
+constexpr int subdivision_schemes = 3;
+
+// points of the next level of n points
+int SubdivisionSize(int scheme, bool closed, int n);
+
+// a control polygon refined level by level. Every level is kept, one after the other in one
+// buffer that only grows, so refining a polygon of the same size again does not allocate, and
+// moving a point recomputes only the window of every level that depends on it.
+struct Subdivision {
+	// slots before and after the points of a level, they hold the neighbours across the ends
+	// so that every pass runs the same stencil over all edges
+	static constexpr int ghost = 2;
+
+	int scheme{ 0 };
+	bool closed{ false };
+
+	// the points of the last refine or limit
+	int size() const { return count.empty() ? 0 : count.back(); }
+	const float* x() const { return bx.data() + offset.back(); }
+	const float* y() const { return by.data() + offset.back(); }
+
+	// the n points of x, y after levels levels
+	void refine(const float* x, const float* y, int n, int levels);
+	// the limit curve of x, y with 2^levels samples per span and the end point of an open
+	// curve. The B-spline schemes are evaluated in closed form without any intermediate level,
+	// the 4-point scheme interpolates its levels, their points already lie on the limit curve.
+	void limit(const float* x, const float* y, int n, int levels);
+	// move point k of the polygon of the last refine or limit and recompute what depends on it,
+	// the points first..last changed. That window grows by the stencil width per level and does
+	// not depend on the size of the polygon, on a closed curve it may wrap around, last < first.
+	void move(int k, float px, float py, int& first, int& last);
+
+private:
+	// points of every level, the last entry is what x(), y() return
+	std::vector<float> bx;
+	std::vector<float> by;
+	std::vector<int> offset;
+	std::vector<int> count;
+	// the last entry holds B-spline spans of per_span samples each rather than a level
+	bool spans{ false };
+	int per_span{ 1 };
+
+	// room for levels of the sizes in count, which start at offset
+	void layout();
+	void load(const float* x, const float* y, int n);
+	void fillGhosts(int l);
+	// edges a..b of level l into level l + 1
+	void pass(int l, int a, int b);
+	// spans a..b of the limit curve
+	void evalSpans(int a, int b);
+};
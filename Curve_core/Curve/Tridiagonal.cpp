@@ -0,0 +1,204 @@
+#include "Tridiagonal.h"
+
+#include "FrameArena.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// rows per block of the partitioned solve, and the most blocks. The blocks do not depend on the
+// number of threads, so neither does the result.
+constexpr int min_block = 4096;
+constexpr int max_blocks = 64;
+
+// Thomas sweep over the rows lo..hi for k right hand sides r[0..k-1], u is scratch of the same size.
+// d_lo and d_hi are added to the diagonal of the first and the last row.
+template<typename T, int k>
+static void thomas(const float* h, int lo, int hi, T* const* r, T* u, T d_lo = T(0), T d_hi = T(0)) {
+	int m = hi - lo + 1;
+	u[0] = T(2) * (T(h[lo - 1]) + T(h[lo])) + d_lo;
+	// Ly = f
+	for (int j = 1; j < m; j++) {
+		int i = lo + j;
+		T l = T(h[i - 1]) / u[j - 1];
+		u[j] = T(2) * (T(h[i - 1]) + T(h[i])) - l * T(h[i - 1]);
+		if (j == m - 1)
+			u[j] += d_hi;
+		for (int c = 0; c < k; c++)
+			r[c][j] -= l * r[c][j - 1];
+	}
+	// UM = Y
+	for (int c = 0; c < k; c++)
+		r[c][m - 1] /= u[m - 1];
+	for (int j = m - 2; j >= 0; j--) {
+		T sup = T(h[lo + j]);
+		for (int c = 0; c < k; c++)
+			r[c][j] = (r[c][j] - sup * r[c][j + 1]) / u[j];
+	}
+}
+
+template<typename T>
+void SolveSplineRows(const float* h, int lo, int hi, T* rx, T* ry, FrameArena& arena) {
+	if (hi < lo)
+		return;
+	T* r[2] = { rx, ry };
+	thomas<T, 2>(h, lo, hi, r, arena.alloc<T>(hi - lo + 1));
+}
+
+template<typename T>
+void SolveSplineRowsParallel(const float* h, int lo, int hi, T* rx, T* ry, FrameArena& arena) {
+	int m = hi - lo + 1;
+	int blocks = std::min(max_blocks, (m + 1) / (min_block + 1));
+	if (blocks < 2) {
+		SolveSplineRows(h, lo, hi, rx, ry, arena);
+		return;
+	}
+	// blocks of rows with one separator row after each but the last, local row indices
+	int* first = arena.alloc<int>(blocks + 1);
+	for (int b = 0; b <= blocks; b++)
+		first[b] = (int)((int64_t)(m + 1) * b / blocks);
+	// the block b is first[b]..first[b + 1] - 2, its separator first[b + 1] - 1
+	T* u = arena.alloc<T>(m);
+	T* v = arena.alloc<T>(m);
+	T* w = arena.alloc<T>(m);
+
+	// every block solved on its own for the right hand sides, for the unit value of the
+	// separator before it in v and for the one after it in w
+	ParallelFor(blocks, 1, [&](int begin, int end) {
+		for (int b = begin; b < end; b++) {
+			int a = first[b], e = first[b + 1] - 2;
+			std::fill(v + a, v + e + 1, T(0));
+			std::fill(w + a, w + e + 1, T(0));
+			if (b > 0)
+				v[a] = T(h[lo + a - 1]);
+			if (b < blocks - 1)
+				w[e] = T(h[lo + e]);
+			T* r[4] = { rx + a, ry + a, v + a, w + a };
+			thomas<T, 4>(h, lo + a, lo + e, r, u + a);
+		}
+	});
+
+	// x_block = y - v x_before - w x_after, so the separator rows only couple to each other
+	int n = blocks - 1;
+	T* sub = arena.alloc<T>(n);
+	T* diag = arena.alloc<T>(n);
+	T* sup = arena.alloc<T>(n);
+	for (int k = 0; k < n; k++) {
+		int s = first[k + 1] - 1;
+		int i = lo + s;
+		T hl = T(h[i - 1]), hr = T(h[i]);
+		sub[k] = -hl * v[s - 1];
+		diag[k] = T(2) * (hl + hr) - hl * w[s - 1] - hr * v[s + 1];
+		sup[k] = -hr * w[s + 1];
+		rx[s] -= hl * rx[s - 1] + hr * rx[s + 1];
+		ry[s] -= hl * ry[s - 1] + hr * ry[s + 1];
+	}
+	// Thomas on the separators, written back in place
+	for (int k = 1; k < n; k++) {
+		int s = first[k + 1] - 1, p = first[k] - 1;
+		T l = sub[k] / diag[k - 1];
+		diag[k] -= l * sup[k - 1];
+		rx[s] -= l * rx[p];
+		ry[s] -= l * ry[p];
+	}
+	int last = first[n] - 1;
+	rx[last] /= diag[n - 1];
+	ry[last] /= diag[n - 1];
+	for (int k = n - 2; k >= 0; k--) {
+		int s = first[k + 1] - 1, q = first[k + 2] - 1;
+		rx[s] = (rx[s] - sup[k] * rx[q]) / diag[k];
+		ry[s] = (ry[s] - sup[k] * ry[q]) / diag[k];
+	}
+
+	ParallelFor(blocks, 1, [&](int begin, int end) {
+		for (int b = begin; b < end; b++) {
+			int a = first[b], e = first[b + 1] - 2;
+			T bx = b > 0 ? rx[a - 1] : T(0), by = b > 0 ? ry[a - 1] : T(0);
+			T ax = b < blocks - 1 ? rx[e + 1] : T(0), ay = b < blocks - 1 ? ry[e + 1] : T(0);
+			for (int j = a; j <= e; j++) {
+				rx[j] -= v[j] * bx + w[j] * ax;
+				ry[j] -= v[j] * by + w[j] * ay;
+			}
+		}
+	});
+}
+
+template<typename T>
+void SolvePeriodicSplineRows(const float* h, int n, T* rx, T* ry, FrameArena& arena) {
+	if (n < 3)
+		return;
+	// rows 1..n of hp are the knots 0..n - 1, so that row i sees hp[i - 1] = h[i - 2]
+	float* hp = arena.alloc<float>(n + 1);
+	hp[0] = h[n - 1];
+	std::copy(h, h + n, hp + 1);
+	// A = B + u v^T with B tridiagonal, u = (g, 0.., 0, c), v = (1, 0.., 0, c / g), where c is
+	// the corner h[n - 1] and g = -b[0] keeps B as well conditioned as A
+	T c = T(h[n - 1]);
+	T g = -T(2) * (T(h[n - 1]) + T(h[0]));
+	T* z = arena.alloc<T>(n);
+	std::fill(z, z + n, T(0));
+	z[0] = g;
+	z[n - 1] = c;
+	T* r[3] = { rx, ry, z };
+	thomas<T, 3>(hp, 1, n, r, arena.alloc<T>(n), -g, -c * c / g);
+	// Sherman-Morrison, x = y - (v.y / (1 + v.z)) z
+	T vz = T(1) + z[0] + c / g * z[n - 1];
+	T fx = (rx[0] + c / g * rx[n - 1]) / vz;
+	T fy = (ry[0] + c / g * ry[n - 1]) / vz;
+	for (int i = 0; i < n; i++) {
+		rx[i] -= fx * z[i];
+		ry[i] -= fy * z[i];
+	}
+}
+
+template<typename T>
+bool CholeskyBand(T* a, int n, int bw) {
+	int w = bw + 1;
+	for (int i = 0; i < n; i++) {
+		// row i from its first entry to the diagonal, L(i, p) L(j, p) over the p both rows reach
+		for (int k = std::min(bw, i); k >= 0; k--) {
+			int j = i - k;
+			T s = a[i * w + k];
+			for (int p = std::max(i - bw, 0); p < j; p++)
+				s -= a[i * w + i - p] * a[j * w + j - p];
+			if (k > 0)
+				a[i * w + k] = s / a[j * w];
+			else if (s > T(0))
+				a[i * w] = std::sqrt(s);
+			else
+				return false;
+		}
+	}
+	return true;
+}
+
+template<typename T>
+void SolveCholeskyBand(const T* a, int n, int bw, T* r) {
+	int w = bw + 1;
+	// L z = r
+	for (int i = 0; i < n; i++) {
+		T s = r[i];
+		for (int p = std::max(i - bw, 0); p < i; p++)
+			s -= a[i * w + i - p] * r[p];
+		r[i] = s / a[i * w];
+	}
+	// L^T v = z
+	for (int i = n - 1; i >= 0; i--) {
+		T s = r[i];
+		for (int q = i + 1; q <= std::min(i + bw, n - 1); q++)
+			s -= a[q * w + q - i] * r[q];
+		r[i] = s / a[i * w];
+	}
+}
+
+template void SolveSplineRows<float>(const float*, int, int, float*, float*, FrameArena&);
+template void SolveSplineRows<double>(const float*, int, int, double*, double*, FrameArena&);
+template void SolveSplineRowsParallel<float>(const float*, int, int, float*, float*, FrameArena&);
+template void SolveSplineRowsParallel<double>(const float*, int, int, double*, double*, FrameArena&);
+template void SolvePeriodicSplineRows<float>(const float*, int, float*, float*, FrameArena&);
+template void SolvePeriodicSplineRows<double>(const float*, int, double*, double*, FrameArena&);
+template bool CholeskyBand<float>(float*, int, int);
+template bool CholeskyBand<double>(double*, int, int);
+template void SolveCholeskyBand<float>(const float*, int, int, float*);
+template void SolveCholeskyBand<double>(const double*, int, int, double*);
@@ -0,0 +1,37 @@
+#pragma once
+
+struct FrameArena;
+
+// the rows lo..hi of the natural spline system in the second derivatives m,
+//   h[i - 1] m[i - 1] + 2 (h[i - 1] + h[i]) m[i] + h[i] m[i + 1] = r[i],
+// with m taken as zero outside lo..hi. rx and ry hold the right hand sides of the rows, x and y
+// share the matrix and are solved together, and get the solution. T is float or double.
+template<typename T>
+void SolveSplineRows(const float* h, int lo, int hi, T* rx, T* ry, FrameArena& arena);
+
+// the same system partitioned into blocks that are solved in parallel, each for its right hand
+// sides and for its couplings to the separator rows between the blocks. The separators form a
+// small tridiagonal system of their own, after which every block is corrected in parallel.
+// About twice the work of SolveSplineRows, worth it above some 10^5 rows on several cores. The
+// blocks only depend on the number of rows, the result is the same on any number of threads but
+// not bit-identical to SolveSplineRows. Fewer than two blocks are solved by SolveSplineRows.
+template<typename T>
+void SolveSplineRowsParallel(const float* h, int lo, int hi, T* rx, T* ry, FrameArena& arena);
+
+// the system of a closed spline through n >= 3 knots, the rows i = 0..n - 1 read
+//   h[i - 1] m[i - 1] + 2 (h[i - 1] + h[i]) m[i] + h[i] m[i + 1] = r[i]
+// with the indices taken mod n. The corners make it cyclic, it is solved in O(n) as a
+// tridiagonal system plus a rank one correction (Sherman-Morrison).
+template<typename T>
+void SolvePeriodicSplineRows(const float* h, int n, T* rx, T* ry, FrameArena& arena);
+
+// Cholesky factor L of a symmetric positive definite band matrix with bw entries on either side
+// of the diagonal, in place and in O(n bw^2). Row i holds a[i * (bw + 1) + k] = A(i, i - k) for
+// k = 0..bw and gets L(i, i - k), the entries left of column 0 are not read. False if a pivot
+// is not positive.
+template<typename T>
+bool CholeskyBand(T* a, int n, int bw);
+
+// solve L L^T v = r for the factor of CholeskyBand, r becomes v
+template<typename T>
+void SolveCholeskyBand(const T* a, int n, int bw, T* r);
@@ -0,0 +1,337 @@
+// micro-benchmark of the curve core, sweeps the number of points and prints the solve time
+// and the cost per sample of every method
+//   curve_bench [max points = 1000000] [samples per segment = 16]
+
+#include <Curve/ArcLength.h>
+#include <Curve/BSpline.h>
+#include <Curve/BSplineFit.h>
+#include <Curve/Bezier.h>
+#include <Curve/BezierCurve.h>
+#include <Curve/CubicEval.h>
+#include <Curve/CurveBvh.h>
+#include <Curve/CurveIntersect.h>
+#include <Curve/FrameArena.h>
+#include <Curve/Lagrange.h>
+#include <Curve/LocalSpline.h>
+#include <Curve/Parallel.h>
+#include <Curve/PointImport.h>
+#include <Curve/PolylineLod.h>
+#include <Curve/Spline.h>
+#include <Curve/Subdivision.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+// the interpolating polynomial is O(n^2) and meaningless for more points anyway
+constexpr int lagrange_max = 1000;
+// how long every method is repeated at least
+constexpr double min_time = 0.1;
+
+// seconds per call of f
+template<typename F>
+double measure(F&& f) {
+	using clock = std::chrono::steady_clock;
+	f();
+	int reps = 0;
+	auto start = clock::now();
+	double elapsed = 0.;
+	do {
+		f();
+		reps++;
+		elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	} while (elapsed < min_time);
+	return elapsed / reps;
+}
+
+// random walk with a slowly turning heading, interleaved x, y
+std::vector<float> walk(int n) {
+	std::mt19937 rng(102);
+	std::uniform_real_distribution<float> turn(-0.6f, 0.6f), step(2.f, 8.f);
+	std::vector<float> xy(2 * n);
+	float x = 0.f, y = 0.f, a = 0.f;
+	for (int i = 0; i < n; i++) {
+		xy[2 * i] = x;
+		xy[2 * i + 1] = y;
+		a += turn(rng);
+		float d = step(rng);
+		x += d * std::cos(a);
+		y += d * std::sin(a);
+	}
+	return xy;
+}
+
+void report(int n, const char* method, double seconds, size_t samples) {
+	if (samples > 0)
+		std::printf("%8d  %-22s %12.2f %10zu %10.2f\n", n, method, seconds * 1e6, samples, seconds * 1e9 / samples);
+	else
+		std::printf("%8d  %-22s %12.2f %10s %10s\n", n, method, seconds * 1e6, "-", "-");
+}
+
+int main(int argc, char** argv) {
+	int max_points = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	int per_segment = argc > 2 ? std::atoi(argv[2]) : 16;
+	const char* param_names[4] = { "uniform", "chordal", "centripetal", "foley" };
+
+	std::printf("%d threads\n", ParallelThreads());
+	std::printf("%8s  %-22s %12s %10s %10s\n", "points", "method", "time (us)", "samples", "ns/sample");
+	for (int n = 10; n <= max_points; n *= 10) {
+		std::vector<float> xy = walk(n);
+		int sample_num = per_segment * (n - 1) + 1;
+		SplineCache s;
+		s.assign(xy.data(), n);
+
+		for (int p = 0; p < 4; p++) {
+			char name[32];
+			std::snprintf(name, sizeof(name), "param %s", param_names[p]);
+			report(n, name, measure([&] { Parameterize(s, p); }), 0);
+		}
+
+		// one point moved, then the last knot, on an incremental parameterization
+		Parameterization param;
+		param.assign(s.x.data(), s.y.data(), n, 3);
+		report(n, "param foley move", measure([&] {
+			param.move(s.x.data(), s.y.data(), n / 2);
+			volatile float t = param.knot(n - 1);
+			(void)t;
+		}), 0);
+
+		Parameterize(s, 1);
+		report(n, "CubicSpline solve", measure([&] { CubicSpline(s); }), 0);
+		s.precise = true;
+		report(n, "CubicSpline solve f64", measure([&] { CubicSpline(s); }), 0);
+		s.precise = false;
+		s.parallel = true;
+		report(n, "CubicSpline solve par", measure([&] { CubicSpline(s); }), 0);
+		s.parallel = false;
+		CubicSpline(s);
+
+		size_t samples = 0;
+		double t = measure([&] {
+			SampleSpline(s, sample_num);
+			SampleAll(s);
+			samples = s.sx.size();
+		});
+		report(n, "CubicSpline sample", t, samples);
+
+		// the slopes of the natural spline, taken as given
+		std::vector<Slope> kx = s.kx, ky = s.ky;
+		t = measure([&] {
+			SlopeSpline(s, kx.data(), ky.data());
+			SampleSpline(s, sample_num);
+			SampleAll(s);
+			samples = s.sx.size();
+		});
+		report(n, "SlopeSpline", t, samples);
+
+		// centripetal Catmull-Rom, then one point moved and its segments evaluated again
+		SplineCache cr;
+		cr.assign(xy.data(), n);
+		t = measure([&] {
+			LocalSpline(cr, 2, SplineShape());
+			SampleAdaptive(cr, 0.25f);
+			SampleAll(cr);
+		});
+		report(n, "Catmull-Rom", t, cr.sx.size());
+		int ids[max_local_segments];
+		int changed = 0;
+		float knot_x = cr.x[n / 2], knot_y = cr.y[n / 2];
+		t = measure([&] {
+			changed = MoveLocalKnot(cr, 2, SplineShape(), n / 2, knot_x + 1.f, knot_y, ids);
+			SampleSegments(cr, ids, changed);
+			MoveLocalKnot(cr, 2, SplineShape(), n / 2, knot_x, knot_y, ids);
+			SampleSegments(cr, ids, changed);
+		});
+		report(n, "Catmull-Rom move", t / 2, 0);
+
+		ArcLengthTable a;
+		report(n, "arc length table", measure([&] { BuildArcLength(a, s); }), 0);
+		std::vector<float> ax(sample_num), ay(sample_num);
+		report(n, "arc length sample", measure([&] { SampleArcLength(a, sample_num, ax.data(), ay.data()); }), sample_num);
+
+		// Bezier through the points, handles from the neighbours as on the canvas
+		std::vector<float> bx(4 * (n - 1)), by(4 * (n - 1));
+		for (int i = 0; i + 1 < n; i++) {
+			int i0 = i > 0 ? i - 1 : i, i2 = i + 2 < n ? i + 2 : i + 1;
+			float* px = &bx[4 * i];
+			float* py = &by[4 * i];
+			px[0] = xy[2 * i];
+			py[0] = xy[2 * i + 1];
+			px[1] = px[0] + (xy[2 * (i + 1)] - xy[2 * i0]) / 6.f;
+			py[1] = py[0] + (xy[2 * (i + 1) + 1] - xy[2 * i0 + 1]) / 6.f;
+			px[3] = xy[2 * (i + 1)];
+			py[3] = xy[2 * (i + 1) + 1];
+			px[2] = px[3] - (xy[2 * i2] - xy[2 * i]) / 6.f;
+			py[2] = py[3] - (xy[2 * i2 + 1] - xy[2 * i + 1]) / 6.f;
+		}
+		std::vector<float> sx(per_segment * (n - 1)), sy(per_segment * (n - 1));
+		t = measure([&] {
+			for (int i = 0; i + 1 < n; i++)
+				EvalCubicUniform(BezierCoeffs(&bx[4 * i], &by[4 * i]), per_segment, &sx[per_segment * i], &sy[per_segment * i]);
+		});
+		report(n, "Bezier uniform", t, sx.size());
+		t = measure([&] {
+			sx.clear();
+			sy.clear();
+			for (int i = 0; i + 1 < n; i++)
+				TessellateBezier(&bx[4 * i], &by[4 * i], 0.25f, sx, sy);
+		});
+		report(n, "Bezier adaptive", t, sx.size());
+		// the same cubics by columns, every curve at one parameter per pass
+		int curves = n - 1;
+		std::vector<float> cx(4 * curves), cy(4 * curves);
+		for (int c = 0; c < curves; c++) {
+			for (int i = 0; i < 4; i++) {
+				cx[i * curves + c] = bx[4 * c + i];
+				cy[i * curves + c] = by[4 * c + i];
+			}
+		}
+		sx.resize(per_segment * curves);
+		sy.resize(per_segment * curves);
+		t = measure([&] {
+			for (int j = 0; j < per_segment; j++)
+				EvalBezierBatch<3>(cx.data(), cy.data(), curves, (float)j / per_segment, &sx[j * curves], &sy[j * curves]);
+		});
+		report(n, "Bezier batch", t, sx.size());
+
+		// the point of the cubics nearest to a query near the walk, per query
+		CurveBvh bvh;
+		report(n, "bvh build", measure([&] { bvh.build(bx.data(), by.data(), n - 1); }), 0);
+		constexpr int queries = 1000;
+		std::vector<float> qx(queries), qy(queries);
+		std::mt19937 qrng(7);
+		std::uniform_real_distribution<float> offset(-20.f, 20.f);
+		for (int q = 0; q < queries; q++) {
+			int i = (int)(qrng() % n);
+			qx[q] = xy[2 * i] + offset(qrng);
+			qy[q] = xy[2 * i + 1] + offset(qrng);
+		}
+		CurveHit hit;
+		t = measure([&] {
+			for (int q = 0; q < queries; q++)
+				bvh.nearest(qx[q], qy[q], std::numeric_limits<float>::infinity(), hit);
+		});
+		report(n, "bvh nearest", t / queries, 0);
+
+		// where the cubics cross themselves, and a copy of them moved aside, per crossing
+		std::vector<CurveCrossing> crossings;
+		t = measure([&] {
+			crossings.clear();
+			SelfIntersections(bvh, 1e-3f, crossings);
+		});
+		report(n, "bvh self crossings", t, crossings.size());
+		std::vector<float> ox(bx), oy(by);
+		for (size_t k = 0; k < ox.size(); k++)
+			ox[k] += 3.f, oy[k] += 2.f;
+		CurveBvh moved;
+		moved.build(ox.data(), oy.data(), n - 1);
+		t = measure([&] {
+			crossings.clear();
+			IntersectCurves(bvh, moved, 1e-3f, crossings);
+		});
+		report(n, "bvh crossings", t, crossings.size());
+		// the same far from the origin, where the coordinates are coarse next to the tolerance
+		for (size_t k = 0; k < ox.size(); k++)
+			ox[k] = bx[k] + 30000.f, oy[k] = by[k] + 30000.f;
+		CurveBvh far;
+		far.build(ox.data(), oy.data(), n - 1);
+		t = measure([&] {
+			crossings.clear();
+			SelfIntersections(far, 1e-3f, crossings);
+		});
+		report(n, "bvh self crossings far", t, crossings.size());
+
+		// the walk as control polygon of a cubic B-spline with chordal knots, then one point moved
+		BSplineCache bs;
+		bs.assign(s.x.data(), s.y.data(), nullptr, n, 3);
+		BSplineKnots(bs, 1);
+		t = measure([&] { SampleBSpline(bs, per_segment); });
+		report(n, "B-spline sample", t, bs.sx.size());
+		int first = 0, last = 0;
+		float mx = bs.x[n / 2], my = bs.y[n / 2];
+		t = measure([&] {
+			MoveControlPoint(bs, n / 2, mx + 1.f, my, 1.f, first, last);
+			MoveControlPoint(bs, n / 2, mx, my, 1.f, first, last);
+		});
+		report(n, "B-spline move", t / 2, (last - first + 1) * per_segment);
+		// the walk approximated by a hundredth of its points, per point
+		BSplineCache fit;
+		FrameArena fit_arena;
+		t = measure([&] {
+			fit_arena.reset();
+			FitBSpline(s.x.data(), s.y.data(), n, std::max(n / 100, 4), 0.f, 1, fit, fit_arena);
+		});
+		report(n, "B-spline fit", t, n);
+
+		// the walk as control polygon, 4 levels of every scheme and the cubic limit at that density
+		const char* scheme_names[subdivision_schemes] = { "Chaikin", "cubic B-spline", "4-point" };
+		Subdivision sub;
+		for (int k = 0; k < subdivision_schemes; k++) {
+			char name[32];
+			std::snprintf(name, sizeof(name), "subdivide %s", scheme_names[k]);
+			sub.scheme = k;
+			t = measure([&] { sub.refine(s.x.data(), s.y.data(), n, 4); });
+			report(n, name, t, sub.size());
+		}
+		sub.scheme = 1;
+		t = measure([&] { sub.limit(s.x.data(), s.y.data(), n, 4); });
+		report(n, "limit cubic B-spline", t, sub.size());
+		// one point of the polygon dragged back and forth, the curve follows in a window around it
+		mx = s.x[n / 2], my = s.y[n / 2];
+		t = measure([&] {
+			sub.move(n / 2, mx + 1.f, my, first, last);
+			sub.move(n / 2, mx, my, first, last);
+		});
+		report(n, "limit move", t / 2, 0);
+		sub.refine(s.x.data(), s.y.data(), n, 4);
+		t = measure([&] {
+			sub.move(n / 2, mx + 1.f, my, first, last);
+			sub.move(n / 2, mx, my, first, last);
+		});
+		report(n, "subdivide move", t / 2, 0);
+
+		// levels of detail of the refined curve, down to the error of a pixel at a zoom of 64
+		PolylineLod lod;
+		FrameArena arena;
+		t = measure([&] {
+			arena.reset();
+			lod.build(sub.x(), sub.y(), sub.size(), 1.f / 64.f, arena);
+		});
+		report(n, "lod build", t, sub.size());
+
+		// the walk as the text of a CSV file and as binary pairs, parsed from memory
+		std::vector<char> csv;
+		char line[64];
+		for (int i = 0; i < n; i++) {
+			int len = std::snprintf(line, sizeof(line), "%.4f,%.4f\n", xy[2 * i], xy[2 * i + 1]);
+			csv.insert(csv.end(), line, line + len);
+		}
+		size_t imported = 0;
+		ImportSink count{ &imported,
+			[](void* c, const float*, const float*, size_t k) { *static_cast<size_t*>(c) += k; },
+			[](void*, size_t, size_t) { return true; } };
+		t = measure([&] { ImportPoints(csv.data(), csv.size(), PointFormat::Csv, count); });
+		report(n, "import csv", t, n);
+		t = measure([&] { ImportPoints(reinterpret_cast<const char*>(xy.data()), xy.size() * sizeof(float), PointFormat::Binary, count); });
+		report(n, "import binary", t, n);
+
+		if (n <= lagrange_max) {
+			std::vector<float> x(n), y(n), h(n - 1), knots(n);
+			for (int i = 0; i < n; i++) {
+				x[i] = xy[2 * i];
+				y[i] = xy[2 * i + 1];
+			}
+			ChordalParameterize(x.data(), y.data(), n, h.data(), 0, n - 2);
+			Knots(h.data(), n, knots.data());
+			std::vector<float> lx(sample_num), ly(sample_num);
+			t = measure([&] { LagrangeCurve(knots.data(), x.data(), y.data(), n, sample_num, lx.data(), ly.data()); });
+			report(n, "Lagrange chordal", t, sample_num);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,333 @@
+// checks that every incremental path of the curve core reproduces its full rebuild, exits with
+// the number of failed checks
+//   curve_check [points = 2000]
+
+#include <Curve/BSpline.h>
+#include <Curve/CurveBvh.h>
+#include <Curve/FrameArena.h>
+#include <Curve/LocalSpline.h>
+#include <Curve/PolylineLod.h>
+#include <Curve/Spline.h>
+#include <Curve/Subdivision.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// moves per configuration, and the re-solve tolerance of MoveKnot
+constexpr int moves = 20;
+constexpr float move_tol = 1e-3f;
+
+int failures = 0;
+
+void check(bool ok, const char* what, int a = 0, int b = 0) {
+	if (ok)
+		return;
+	failures++;
+	if (failures <= 20)
+		std::printf("FAILED %s (%d, %d)\n", what, a, b);
+}
+
+// random walk with a slowly turning heading
+void walk(int n, unsigned seed, std::vector<float>& x, std::vector<float>& y) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> turn(-0.6f, 0.6f), step(2.f, 8.f);
+	x.resize(n);
+	y.resize(n);
+	float px = 0.f, py = 0.f, a = 0.f;
+	for (int i = 0; i < n; i++) {
+		x[i] = px;
+		y[i] = py;
+		a += turn(rng);
+		float d = step(rng);
+		px += d * std::cos(a);
+		py += d * std::sin(a);
+	}
+}
+
+template<typename T>
+bool same(const std::vector<T>& a, const std::vector<T>& b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+bool sameSlopes(const std::vector<Slope>& a, const std::vector<Slope>& b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+		[](const Slope& l, const Slope& r) { return l.l == r.l && l.r == r.r; });
+}
+
+// batched, parallel sampling lays out the same samples as one segment after the other
+void checkSampling(const std::vector<float>& x, const std::vector<float>& y) {
+	int n = (int)x.size();
+	for (int adaptive = 0; adaptive < 2; adaptive++) {
+		SplineCache s;
+		s.assign(x.data(), y.data(), n);
+		Parameterize(s, 1);
+		CubicSpline(s);
+		if (adaptive)
+			SampleAdaptive(s, 0.25f);
+		else
+			SampleSpline(s, 16 * n);
+		SplineCache one = s;
+		SampleAll(s);
+		for (int i = 0; i < one.segments(); i++)
+			SampleSegment(one, i);
+		check(same(s.sx, one.sx) && same(s.sy, one.sy) && same(s.offset, one.offset), "SampleAll == SampleSegment", adaptive);
+	}
+}
+
+// a moved knot of the natural spline stays within the tolerance of a full solve, and its end
+// slopes mirror the inner ones as those of CubicSpline do
+void checkMoveKnot(const std::vector<float>& x0, const std::vector<float>& y0) {
+	int n = (int)x0.size();
+	std::mt19937 rng(11);
+	FrameArena arena;
+	for (int p = 0; p < 4; p++) {
+		for (int m = 0; m < moves; m++) {
+			std::vector<float> x = x0, y = y0;
+			SplineCache s;
+			s.assign(x.data(), y.data(), n);
+			Parameterize(s, p);
+			CubicSpline(s);
+			SampleAdaptive(s, 0.25f);
+			// the ends and their neighbours, then anywhere
+			int k = m < 4 ? (m < 2 ? m : n - 3 + m - 2) : (int)(rng() % n);
+			x[k] += 5.f;
+			y[k] -= 3.f;
+			int first, last, lo, hi;
+			arena.reset();
+			MoveKnot(s, p, k, x[k], y[k], move_tol, arena, first, last, lo, hi);
+			SplineCache f;
+			f.assign(x.data(), y.data(), n);
+			Parameterize(f, p);
+			CubicSpline(f);
+			float worst = 0.f;
+			const float t[3] = { 0.25f, 0.5f, 0.75f };
+			for (int i = 0; i < f.segments(); i++) {
+				float ax[3], ay[3], bx[3], by[3];
+				EvalCubic(SegmentCoeffs(s, i), t, 3, ax, ay);
+				EvalCubic(SegmentCoeffs(f, i), t, 3, bx, by);
+				for (int j = 0; j < 3; j++)
+					worst = std::max(worst, std::max(std::fabs(ax[j] - bx[j]), std::fabs(ay[j] - by[j])));
+			}
+			check(worst <= 2.f * move_tol, "MoveKnot within tol of CubicSpline", p, k);
+			int e = s.segments();
+			check(s.kx[0].l == s.kx[0].r && s.ky[0].l == s.ky[0].r
+				&& s.kx[e].r == s.kx[e].l && s.ky[e].r == s.ky[e].l, "MoveKnot mirrors the end slopes", p, k);
+		}
+	}
+}
+
+// a moved knot of the local spline gives the intervals and slopes of a full build bit for bit,
+// and every segment whose control points differ is one it reports
+void checkLocalSpline(const std::vector<float>& x0, const std::vector<float>& y0) {
+	std::mt19937 rng(13);
+	SplineShape shapes[2] = { {}, { 0.3f, -0.2f, 0.4f } };
+	for (int closed = 0; closed < 2; closed++) {
+		for (int p = 0; p < 4; p++) {
+			for (const SplineShape& shape : shapes) {
+				std::vector<float> x = x0, y = y0;
+				int n = (int)x.size();
+				SplineCache s;
+				s.closed = closed;
+				s.assign(x.data(), y.data(), n);
+				LocalSpline(s, p, shape);
+				SampleAdaptive(s, 0.25f);
+				for (int m = 0; m < moves; m++) {
+					int k = m < 2 ? m * (n - 1) : (int)(rng() % n);
+					x[k] += 4.f;
+					y[k] += 1.f;
+					SplineCache before = s;
+					int ids[max_local_segments];
+					int c = MoveLocalKnot(s, p, shape, k, x[k], y[k], ids);
+					SplineCache f;
+					f.closed = closed;
+					f.assign(x.data(), y.data(), n);
+					LocalSpline(f, p, shape);
+					check(same(s.h, f.h) && sameSlopes(s.kx, f.kx) && sameSlopes(s.ky, f.ky), "MoveLocalKnot == LocalSpline", p, k);
+					for (int i = 0; i < s.segments(); i++) {
+						float ax[4], ay[4], bx[4], by[4];
+						ControlPoints(s, i, ax, ay);
+						ControlPoints(before, i, bx, by);
+						bool moved = !std::equal(ax, ax + 4, bx) || !std::equal(ay, ay + 4, by);
+						check(!moved || std::find(ids, ids + c, i) != ids + c, "MoveLocalKnot reports its segments", k, i);
+					}
+				}
+			}
+		}
+	}
+}
+
+// a moved control point of a B-spline samples its spans as a full sampling with the same knots
+void checkBSpline(const std::vector<float>& x, const std::vector<float>& y) {
+	int n = (int)x.size();
+	std::mt19937 rng(17);
+	for (int degree = 1; degree <= std::min(5, n - 1); degree++) {
+		BSplineCache b;
+		b.assign(x.data(), y.data(), nullptr, n, degree);
+		BSplineKnots(b, 1);
+		SampleBSpline(b, 16);
+		for (int m = 0; m < moves; m++) {
+			int k = m < 2 ? m * (n - 1) : (int)(rng() % n);
+			int first, last;
+			MoveControlPoint(b, k, b.x[k] - 2.f, b.y[k] + 6.f, m % 3 == 0 ? 2.f : 1.f, first, last);
+			BSplineCache f = b;
+			SampleBSpline(f, 16);
+			check(same(b.sx, f.sx) && same(b.sy, f.sy) && same(b.box, f.box), "MoveControlPoint == SampleBSpline", degree, k);
+		}
+	}
+}
+
+// a moved point of a subdivided polygon gives every point of a full refine or limit bit for bit
+void checkSubdivision(const std::vector<float>& x0, const std::vector<float>& y0) {
+	std::mt19937 rng(19);
+	for (int scheme = 0; scheme < subdivision_schemes; scheme++) {
+		for (int closed = 0; closed < 2; closed++) {
+			for (int limit = 0; limit < 2; limit++) {
+				std::vector<float> x = x0, y = y0;
+				int n = (int)x.size();
+				int levels = 4;
+				Subdivision s, f;
+				s.scheme = f.scheme = scheme;
+				s.closed = f.closed = closed;
+				if (limit)
+					s.limit(x.data(), y.data(), n, levels);
+				else
+					s.refine(x.data(), y.data(), n, levels);
+				for (int m = 0; m < moves; m++) {
+					int k = m < 2 ? m * (n - 1) : (int)(rng() % n);
+					x[k] += 3.f;
+					y[k] -= 7.f;
+					int first, last;
+					s.move(k, x[k], y[k], first, last);
+					if (limit)
+						f.limit(x.data(), y.data(), n, levels);
+					else
+						f.refine(x.data(), y.data(), n, levels);
+					bool ok = s.size() == f.size()
+						&& std::equal(s.x(), s.x() + s.size(), f.x())
+						&& std::equal(s.y(), s.y() + s.size(), f.y());
+					check(ok, limit ? "Subdivision move == limit" : "Subdivision move == refine", scheme, k);
+				}
+			}
+		}
+	}
+}
+
+// refitting the changed leaves gives the boxes of a fresh build
+void checkBvh(const std::vector<float>& x, const std::vector<float>& y) {
+	int m = (int)x.size() - 1;
+	std::vector<float> cx(4 * m), cy(4 * m);
+	for (int i = 0; i < m; i++) {
+		for (int j = 0; j < 4; j++) {
+			cx[4 * i + j] = x[i] + (x[i + 1] - x[i]) * j / 3.f;
+			cy[4 * i + j] = y[i] + (y[i + 1] - y[i]) * j / 3.f;
+		}
+	}
+	CurveBvh b;
+	b.build(cx.data(), cy.data(), m);
+	std::mt19937 rng(23);
+	for (int k = 0; k < moves; k++) {
+		int i = (int)(rng() % m);
+		for (int j = 0; j < 4; j++)
+			cx[4 * i + j] += 10.f, cy[4 * i + j] -= 4.f;
+		b.update(i, i, &cx[4 * i], &cy[4 * i]);
+	}
+	CurveBvh f;
+	f.build(cx.data(), cy.data(), m);
+	// a perfect tree of leaves nodes has leaves - 1 inner ones
+	int inner = 0;
+	while (!f.isLeaf(inner))
+		inner++;
+	bool ok = true;
+	for (int k = 0; k < 2 * inner + 1; k++)
+		ok = ok && std::equal(b.nodeBox(k), b.nodeBox(k) + 4, f.nodeBox(k));
+	check(ok, "CurveBvh update == build");
+}
+
+// a level with edits applied draws the edited polyline, level 0 point for point and every
+// coarser level as a subsequence of it with the same ends
+void checkLod(const std::vector<float>& x, const std::vector<float>& y) {
+	int n = (int)x.size();
+	if (n < 200)
+		return;
+	FrameArena arena;
+	PolylineLod lod;
+	lod.build(x.data(), y.data(), n, 0.01f, arena);
+	std::mt19937 rng(29);
+	for (int m = 0; m < moves; m++) {
+		arena.reset();
+		// two windows, each replaced by a moved copy with a point between every two of its points
+		int a = (int)(rng() % (n / 2 - 50)), c = n / 2 + (int)(rng() % (n / 2 - 50));
+		int first[2] = { a, c }, last[2] = { a + (int)(rng() % 40), c + (int)(rng() % 40) };
+		std::vector<float> rx[2], ry[2];
+		PolylineEdit edits[2];
+		for (int e = 0; e < 2; e++) {
+			for (int i = first[e]; i <= last[e]; i++) {
+				rx[e].push_back(x[i] + 3.f);
+				ry[e].push_back(y[i] - 2.f);
+				if (i < last[e]) {
+					rx[e].push_back((x[i] + x[i + 1]) / 2.f + 3.f);
+					ry[e].push_back((y[i] + y[i + 1]) / 2.f - 2.f);
+				}
+			}
+			edits[e] = { first[e], last[e], rx[e].data(), ry[e].data(), (int)rx[e].size() };
+		}
+		std::vector<float> ex, ey;
+		int from = 0;
+		for (int e = 0; e < 2; e++) {
+			ex.insert(ex.end(), x.begin() + from, x.begin() + first[e]);
+			ey.insert(ey.end(), y.begin() + from, y.begin() + first[e]);
+			ex.insert(ex.end(), rx[e].begin(), rx[e].end());
+			ey.insert(ey.end(), ry[e].begin(), ry[e].end());
+			from = last[e] + 1;
+		}
+		ex.insert(ex.end(), x.begin() + from, x.end());
+		ey.insert(ey.end(), y.begin() + from, y.end());
+		for (int l = 0; l < lod.levels(); l++) {
+			// the runs share their end points
+			std::vector<float> dx, dy;
+			lod.forEachRun(l, -1e30f, -1e30f, 1e30f, 1e30f, edits, 2, arena, [&](const float* px, const float* py, int size) {
+				int j = dx.empty() ? 0 : 1;
+				dx.insert(dx.end(), px + j, px + size);
+				dy.insert(dy.end(), py + j, py + size);
+			});
+			bool ok;
+			if (l == 0)
+				ok = dx == ex && dy == ey;
+			else {
+				size_t j = 0;
+				for (size_t i = 0; i < ex.size() && j < dx.size(); i++) {
+					if (ex[i] == dx[j] && ey[i] == dy[j])
+						j++;
+				}
+				ok = j == dx.size() && dx.front() == ex.front() && dx.back() == ex.back();
+			}
+			check(ok, "PolylineLod edits == edited polyline", l, m);
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	int n = argc > 1 ? std::atoi(argv[1]) : 2000;
+	std::vector<float> x, y;
+	walk(n, 102, x, y);
+	checkSampling(x, y);
+	checkMoveKnot(x, y);
+	checkLocalSpline(x, y);
+	checkBSpline(x, y);
+	checkSubdivision(x, y);
+	checkBvh(x, y);
+	checkLod(x, y);
+	// short curves take the special cases at the ends
+	for (int m : { 2, 3, 4, 7 }) {
+		walk(m, 7, x, y);
+		checkLocalSpline(x, y);
+		checkBSpline(x, y);
+		checkSubdivision(x, y);
+	}
+	std::printf("%d failed\n", failures);
+	return failures;
+}
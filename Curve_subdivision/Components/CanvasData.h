@@ -2,68 +2,120 @@
 
 #include <UGM/UGM.h>
 
-struct Slope {
-	float l;
-	float r;
-};
+#include <Curve/FrameArena.h>
+#include <Curve/PolylineLod.h>
+#include <Curve/Subdivision.h>
 
-struct Ratio {
-	float l;
-	float r;
-	Ratio() { l = r = 1.f; }
-};
+#include <vector>
 
 struct CanvasData {
-	std::vector<Ubpa::pointf2> points;
-
-	std::vector<Ubpa::pointf2> ltangent;
-	std::vector<Ubpa::pointf2> rtangent;
-	std::vector<Ratio> tangent_ratio;
-	std::vector<Slope> xk;
-	std::vector<Slope> yk;
+	// control polygon as x and y columns, as the subdivision reads them
+	std::vector<float> x;
+	std::vector<float> y;
 
 	Ubpa::valf2 scrolling{ 0.f,0.f };
+	// pixels per unit of the canvas
+	float zoom{ 1.f };
 	bool opt_enable_grid{ true };
 	bool opt_enable_context_menu{ true };
 	bool adding_line{ false };
 
-	int param_type{ 0 };
-	int fitting_type{ 0 };
+	// Chaikin, cubic B-spline or 4-point, see Subdivision.h
+	int scheme{ 0 };
+	int levels{ 4 };
+	bool closed{ false };
+	// draw the limit curve at the density of the last level instead of the level itself
+	bool show_limit{ false };
+	bool show_polygon{ true };
 	bool enable_add_point{ true };
 	bool adding_last_point{ false };
 	int edit_point{ 0 };
 	int editing_index = -1;
 	bool enable_move_point{ false };
-	int editing_tan_index = 0; // < 0 is left, > 0 is right, real index = this - 1
-	bool enable_move_tan{ false };
+
+	// the curve drawn from the polygon, refined again only after a change. A dragged point
+	// only moves the curve, x and y follow when the drag ends.
+	Subdivision curve;
+	bool curve_valid{ false };
+	bool curve_dragged{ false };
+	// the points of the curve a drag moved, may wrap around the end of a closed curve
+	int drag_first{ 0 };
+	int drag_last{ -1 };
+	// the curve simplified for every zoom, patched around a drag and built again after it
+	PolylineLod curve_lod;
+	bool lod_valid{ false };
+	// scratch memory of one frame, reset at the start of every update
+	FrameArena frame_arena;
+
+	int size() const { return (int)x.size(); }
+	Ubpa::pointf2 point(int i) const { return Ubpa::pointf2(x[i], y[i]); }
 
 	void pop_back() {
-		points.pop_back();
-		ltangent.pop_back();
-		rtangent.pop_back();
-		xk.pop_back();
-		yk.pop_back();
-		tangent_ratio.pop_back();
+		x.pop_back();
+		y.pop_back();
+		curve_valid = false;
 	}
 
 	void clear() {
-		points.clear();
-		ltangent.clear();
-		rtangent.clear();
-		xk.clear();
-		yk.clear();
-		tangent_ratio.clear();
+		x.clear();
+		y.clear();
+		curve_valid = false;
 	}
 
 	void push_back(const Ubpa::pointf2& p) {
-		points.push_back(p);
-		ltangent.push_back(Ubpa::pointf2());
-		rtangent.push_back(Ubpa::pointf2());
-		xk.push_back(Slope());
-		yk.push_back(Slope());
-		tangent_ratio.push_back(Ratio());
+		x.push_back(p[0]);
+		y.push_back(p[1]);
+		curve_valid = false;
+	}
+
+	// setters only invalidate the curve when the value really changes
+	void set_point(int i, const Ubpa::pointf2& p) {
+		if (x[i] == p[0] && y[i] == p[1])
+			return;
+		x[i] = p[0];
+		y[i] = p[1];
+		curve_valid = false;
+	}
+
+	// move point i of the curve alone, only the window of every level around it is recomputed
+	void drag_point(int i, const Ubpa::pointf2& p) {
+		curve.move(i, p[0], p[1], drag_first, drag_last);
+		curve_dragged = true;
+	}
+
+	// the curve already has point i at p
+	void commit_drag(int i, const Ubpa::pointf2& p) {
+		x[i] = p[0];
+		y[i] = p[1];
+		curve_dragged = false;
+		lod_valid = false;
+	}
+
+	// a drag that ended without a commit left the curve out of date
+	void cancel_drag() {
+		if (curve_dragged)
+			curve_valid = false, curve_dragged = false;
+	}
+
+	void set_scheme(int s) {
+		if (scheme != s)
+			scheme = s, curve_valid = false;
+	}
+
+	void set_levels(int l) {
+		if (levels != l)
+			levels = l, curve_valid = false;
+	}
+
+	void set_closed(bool c) {
+		if (closed != c)
+			closed = c, curve_valid = false;
+	}
+
+	void set_show_limit(bool l) {
+		if (show_limit != l)
+			show_limit = l, curve_valid = false;
 	}
 };
 
 #include "details/CanvasData_AutoRefl.inl"
-
@@ -1,10 +1,15 @@
 #pragma once
 
 #include <UGM/UGM.h>
-#include <Eigen/Core>
+
+#include <Curve/Parameterization.h>
+
+#include <array>
 
 struct CanvasData {
-	std::vector<Ubpa::pointf2> points;
+	// points as columns, so that the parameterizations read them in place
+	std::vector<float> x;
+	std::vector<float> y;
 	Ubpa::valf2 scrolling{ 0.f,0.f };
 	bool opt_enable_grid{ true };
 	bool opt_enable_context_menu{ true };
@@ -15,10 +20,38 @@ struct CanvasData {
 	bool drawCentripetalParameterization = false;
 	bool drawFoleyParameterization = false;
 
-	Eigen::VectorXf uniformParameterization;
-	Eigen::VectorXf chordalParameterization;
-	Eigen::VectorXf centripetalParameterization;
-	Eigen::VectorXf foleyParameterization;
+	// kept up to date point by point, the knots are only summed when drawn
+	Parameterization uniformParameterization{ 0 };
+	Parameterization chordalParameterization{ 1 };
+	Parameterization centripetalParameterization{ 2 };
+	Parameterization foleyParameterization{ 3 };
+
+	size_t size() const { return x.size(); }
+
+	void push_back(const Ubpa::pointf2& p) {
+		x.push_back(p[0]);
+		y.push_back(p[1]);
+		for (Parameterization* param : parameterizations())
+			param->push_back(x.data(), y.data());
+	}
+
+	void pop_back() {
+		x.pop_back();
+		y.pop_back();
+		for (Parameterization* param : parameterizations())
+			param->pop_back(x.data(), y.data());
+	}
+
+	void clear() {
+		x.clear();
+		y.clear();
+		for (Parameterization* param : parameterizations())
+			param->clear();
+	}
+
+	std::array<Parameterization*, 4> parameterizations() {
+		return { &uniformParameterization, &chordalParameterization, &centripetalParameterization, &foleyParameterization };
+	}
 };
 
 #include "details/CanvasData_AutoRefl.inl"
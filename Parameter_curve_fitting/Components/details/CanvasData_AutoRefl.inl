@@ -13,7 +13,8 @@ struct Ubpa::USRefl::TypeInfo<CanvasData> :
 #endif
     static constexpr AttrList attrs = {};
     static constexpr FieldList fields = {
-        Field {TSTR("points"), &Type::points},
+        Field {TSTR("x"), &Type::x},
+        Field {TSTR("y"), &Type::y},
         Field {TSTR("scrolling"), &Type::scrolling, AttrList {
             Attr {TSTR(UMeta::initializer), []()->Ubpa::valf2{ return { 0.f,0.f }; }},
         }},
@@ -6,26 +6,12 @@
 
 #include <Eigen/Dense>
 
-#include <cmath>
-
-#define M_PI 3.14159265358979323846
+#include <Curve/Lagrange.h>
 
 using namespace Ubpa;
 
-void updateParameterization(CanvasData* data);
-
-void updateUniformParameterization(CanvasData* data);
-void updateChordalParameterization(CanvasData* data);
-void updateCentripetalParameterization(CanvasData* data);
-void updateFoleyParameterization(CanvasData* data);
-
 void drawParameterization(CanvasData* data, ImDrawList* draw_list, int num_samples, const ImVec2 origin);
 
-ImVec2 lagrangeInterpolation(float t, const Eigen::VectorXf& parameterization, const std::vector<Ubpa::pointf2>& points);
-
-float _getAlpha(int i, const std::vector<Ubpa::pointf2>& points);
-
-
 void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 	schedule.RegisterCommand([](Ubpa::UECS::World* w) {
 		auto data = w->entityMngr.GetSingleton<CanvasData>();
@@ -108,7 +94,7 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 
 			// add points to draw
 			if (is_hovered && ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
-				data->points.push_back(mouse_pos_in_canvas);
+				data->push_back(mouse_pos_in_canvas);
 			}
 
 			// Pan (we use a zero mouse threshold when there's no context menu)
@@ -126,12 +112,14 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 				ImGui::OpenPopupContextItem("context");
 			if (ImGui::BeginPopup("context"))
 			{
-				if (data->adding_line)
-					data->points.resize(data->points.size() - 2);
+				if (data->adding_line) {
+					data->pop_back();
+					data->pop_back();
+				}
 				data->adding_line = false;
 				// if (ImGui::MenuItem("Remove one", NULL, false, data->points.size() > 0)) { data->points.resize(data->points.size() - 2); }
-				if (ImGui::MenuItem("Remove one", NULL, false, data->points.size() > 0)) { data->points.resize(data->points.size() - 1); }
-				if (ImGui::MenuItem("Remove all", NULL, false, data->points.size() > 0)) { data->points.clear(); }
+				if (ImGui::MenuItem("Remove one", NULL, false, data->size() > 0)) { data->pop_back(); }
+				if (ImGui::MenuItem("Remove all", NULL, false, data->size() > 0)) { data->clear(); }
 				ImGui::EndPopup();
 			}
 
@@ -148,14 +136,11 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 			/*for (int n = 0; n < data->points.size(); n += 2)
 				draw_list->AddLine(ImVec2(origin.x + data->points[n][0], origin.y + data->points[n][1]), ImVec2(origin.x + data->points[n + 1][0], origin.y + data->points[n + 1][1]), IM_COL32(255, 255, 0, 255), 2.0f);
 			*/
-			for (size_t i = 0; i < data->points.size(); i++)
+			for (size_t i = 0; i < data->size(); i++)
 			{
-				draw_list->AddCircleFilled(ImVec2(origin.x + data->points[i][0], origin.y + data->points[i][1]), 3.0f, IM_COL32(255, 255, 0, 255));
+				draw_list->AddCircleFilled(ImVec2(origin.x + data->x[i], origin.y + data->y[i]), 3.0f, IM_COL32(255, 255, 0, 255));
 			}
 
-			// Update Parameterization
-			updateParameterization(data);
-
 			// Draw Curves
 			drawParameterization(data, draw_list, 1000, origin);
 				
@@ -167,201 +152,34 @@ void CanvasSystem::OnUpdate(Ubpa::UECS::Schedule& schedule) {
 }
 
 
-void updateParameterization(CanvasData* data) {
-	if (data->points.empty()) return;
-
-	// Uniform Parameterization
-	updateUniformParameterization(data);
-
-	// Chordal Parameterization
-	updateChordalParameterization(data);
-
-	// Centripetal Parameterization
-	updateCentripetalParameterization(data);
-
-	// Foley-Nielson Parameterization
-	updateFoleyParameterization(data);
-}
-
-void updateUniformParameterization(CanvasData* data) {
-	int n = data->points.size();
-	data->uniformParameterization = Eigen::VectorXf::LinSpaced(n, 0, 1);
-}
-
-void updateChordalParameterization(CanvasData* data) {
-	int n = data->points.size();
-	data->chordalParameterization = Eigen::VectorXf::Zero(n);
-	if (n == 1 || n == 2) {
-		data->chordalParameterization(n - 1) = 1;
-		return;
-	}
-	for (size_t i = 0; i < n - 1; ++i) {
-		float dx = data->points[i + 1][0] - data->points[i][0];
-		float dy = data->points[i + 1][1] - data->points[i][1];
-		float chord = sqrt(dx * dx + dy + dy);
-		data->chordalParameterization[i + 1] = data->chordalParameterization[1] + chord;
-	}
-}
-
-void updateCentripetalParameterization(CanvasData* data) {
-	int n = data->points.size();
-	data->centripetalParameterization = Eigen::VectorXf::Zero(n);
-	if (n == 1 || n == 2)
-	{
-		data->centripetalParameterization(n - 1) = 1;
-		return;
-	}
-
-	for (size_t i = 0; i < n - 1; ++i)
-	{
-		float dx = data->points[i + 1][0] - data->points[i][0];
-		float dy = data->points[i + 1][1] - data->points[i][1];
-		float chord = sqrt(dx * dx + dy * dy);
-		chord = sqrt(chord);
-		data->centripetalParameterization[i + 1] = data->centripetalParameterization[i] + chord;
-	}
-}
-
-void updateFoleyParameterization(CanvasData* data) {
-	int n = data->points.size();
-	data->foleyParameterization = Eigen::VectorXf::Zero(n);
-	if (n == 1 || n == 2) {
-		data->foleyParameterization(n - 1) = 1;
-		return;
-	}
-	float d_prev = 0, d_next = 0;
-	for (size_t i = 0; i < n - 1; ++i) {
-		float dx = data->points[i + 1][0] - data->points[i][0];
-		float dy = data->points[i + 1][1] - data->points[i][1];
-		float chord = sqrt(dx * dx + dy * dy);
-
-		if (i == n - 2) d_next = 0;
-		else {
-			float dx = data->points[i + 2][0] - data->points[i + 1][0];
-			float dy = data->points[i + 2][1] - data->points[i + 1][1];
-
-			d_next = sqrt(dx * dx + dy * dy);
-		}
-
-		float factor = 1.0;
-		if (i == 0) {
-			float theta_next = fminf(M_PI / 2, _getAlpha(i + 1, data->points));
-			factor = 1 + 1.5 * (theta_next * d_next) / (chord + d_next);
-		}
-		else if (i == n - 2) {
-			float theta = fminf(M_PI / 2, _getAlpha(i, data->points));
-			factor = 1 + 1.5 * (theta * d_prev) / (d_prev + chord);
-		}
-		else {
-			float theta = fminf(M_PI / 2, _getAlpha(i, data->points));
-			float theta_next = fminf(M_PI / 2, _getAlpha(i + 1, data->points));
-
-			factor = 1 + 1.5 * (theta * d_prev) / (d_prev + chord) + 1.5 * (theta_next * d_next) / (chord + d_next);
-		}
-
-		data->foleyParameterization[i + 1] = data->foleyParameterization[i] + chord * factor;
-		d_prev = chord;
-	}
-	data->foleyParameterization = data->foleyParameterization / data->foleyParameterization[n - 1];
-}
-
-float _getAlpha(int i, const std::vector<Ubpa::pointf2>& points) {
-	float dx, dy;
-	// d_prev
-	dx = points[i][0] - points[i - 1][0];
-	dy = points[i][1] - points[i - 1][1];
-	float d_prev = sqrt(dx * dx + dy * dy);
-
-	// d_next
-	dx = points[i + 1][0] - points[i][0];
-	dy = points[i + 1][1] - points[i][1];
-	float d_next = sqrt(dx * dx + dy * dy);
-
-	// l2
-	dx = points[i + 1][0] - points[i - 1][0];
-	dy = points[i + 1][1] - points[i - 1][1];
-	float l2 = dx * dx + dy * dy;
-
-	float alpha = M_PI - acos((d_prev * d_prev + d_next * d_next - l2 / (2 * d_next * d_prev)));
-
-	return alpha;
+void drawLagrange(const std::vector<float>& x, const std::vector<float>& y, Parameterization& param,
+	ImDrawList* draw_list, int num_samples, const ImVec2 origin, ImU32 col) {
+	std::vector<float> ox(num_samples), oy(num_samples);
+	LagrangeCurve(param.knotVector().data(), x.data(), y.data(), x.size(), num_samples, ox.data(), oy.data());
+	std::vector<ImVec2> result(num_samples);
+	for (int i = 0; i < num_samples; i++)
+		result[i] = ImVec2(origin.x + ox[i], origin.y + oy[i]);
+	draw_list->AddPolyline(result.data(), result.size(), col, false, 1.0f);
 }
 
 void drawParameterization(CanvasData* data, ImDrawList* draw_list, int num_samples, const ImVec2 origin) {
-	if (data->points.empty()) return;
-
-	Eigen::VectorXf T = Eigen::VectorXf::LinSpaced(num_samples, 0, 1);
+	if (data->x.empty()) return;
+	const std::vector<float>& x = data->x;
+	const std::vector<float>& y = data->y;
 
 	// Uniform Parameterization
-	if (data->drawUniformParameterization) {
-		std::vector<ImVec2> uniformResult;
-		for (size_t i = 0; i < num_samples; i++)
-		{
-			ImVec2 point = lagrangeInterpolation(T[i], data->uniformParameterization, data->points);
-			uniformResult.push_back(ImVec2(origin.x + point.x, origin.y + point.y));
-		}
-		draw_list->AddPolyline(uniformResult.data(), uniformResult.size(), IM_COL32(255, 0, 0, 255), false, 1.0f);
-	}
+	if (data->drawUniformParameterization)
+		drawLagrange(x, y, data->uniformParameterization, draw_list, num_samples, origin, IM_COL32(255, 0, 0, 255));
 
 	// Chordal Parameterization
 	if (data->drawChordalParameterization)
-	{
-		std::vector<ImVec2> chordalResult;
-		T = Eigen::VectorXf::LinSpaced(num_samples, 0, data->chordalParameterization.tail(1)(0));
-		for (size_t i = 0; i < num_samples; i++)
-		{
-			ImVec2 point = lagrangeInterpolation(T[i], data->chordalParameterization, data->points);
-			chordalResult.push_back(ImVec2(origin.x + point.x, origin.y + point.y));
-		}
-		draw_list->AddPolyline(chordalResult.data(), chordalResult.size(), IM_COL32(0, 255, 0, 255), false, 1.0f);
-	}
+		drawLagrange(x, y, data->chordalParameterization, draw_list, num_samples, origin, IM_COL32(0, 255, 0, 255));
 
 	// Centripetal Parameterization
 	if (data->drawCentripetalParameterization)
-	{
-		std::vector<ImVec2> centripetalResult;
-		T = Eigen::VectorXf::LinSpaced(num_samples, 0, data->centripetalParameterization.tail(1)(0));
-		for (size_t i = 0; i < num_samples; i++)
-		{
-			ImVec2 point = lagrangeInterpolation(T[i], data->centripetalParameterization, data->points);
-			centripetalResult.push_back(ImVec2(origin.x + point.x, origin.y + point.y));
-		}
-		draw_list->AddPolyline(centripetalResult.data(), centripetalResult.size(), IM_COL32(0, 255, 255, 255), false, 1.0f);
-	}
+		drawLagrange(x, y, data->centripetalParameterization, draw_list, num_samples, origin, IM_COL32(0, 255, 255, 255));
 
 	// Foley-Nielson Parameterization
 	if (data->drawFoleyParameterization)
-	{
-		std::vector<ImVec2> foleyResult;
-		T = Eigen::VectorXf::LinSpaced(num_samples, 0, data->foleyParameterization.tail(1)(0));
-		for (size_t i = 0; i < num_samples; i++)
-		{
-			ImVec2 point = lagrangeInterpolation(T[i], data->foleyParameterization, data->points);
-			foleyResult.push_back(ImVec2(origin.x + point.x, origin.y + point.y));
-		}
-		draw_list->AddPolyline(foleyResult.data(), foleyResult.size(), IM_COL32(255, 0, 255, 255), false, 1.0f);
-	}
-}
-
-ImVec2 lagrangeInterpolation(float t, const Eigen::VectorXf& parameterization, const std::vector<Ubpa::pointf2>& points) {
-	int n = points.size();
-	for (size_t i = 0; i < n; i++)
-	{
-		if (t == parameterization[i]) return ImVec2(points[i][0], points[i][1]);
-	}
-
-	float x = 0, y = 0;
-	for (size_t j = 0; j < n; j++)
-	{
-		float l = 1.0;
-		for (size_t i = 0; i < n; i++) {
-			if (j == i) continue;
-			l = l * (t - parameterization[i]) / (parameterization[j] - parameterization[i]);
-		}
-
-		x = x + points[j][0] * l;
-		y = y + points[j][1] * l;
-	}
-
-	return ImVec2(x, y);
+		drawLagrange(x, y, data->foleyParameterization, draw_list, num_samples, origin, IM_COL32(255, 0, 255, 255));
 }